@@ -11,6 +11,7 @@
  * BSD Licensed as described in the file LICENSE
  */
 
+#include <string.h>
 #include <esp_log.h>
 #include "ads111x.h"
 
@@ -40,6 +41,8 @@
 #define OS_OFFSET        15
 #define OS_MASK          0x01
 
+#define CONFIG_CACHE_MASK ((uint16_t)~(OS_MASK << OS_OFFSET))
+
 #define CHECK(x) do { esp_err_t __; if ((__ = x) != ESP_OK) return __; } while (0)
 #define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
 
@@ -56,10 +59,29 @@ const float ads111x_gain_values[] = {
     [ADS111X_GAIN_0V256_3] = 0.256
 };
 
+/**
+ * Shadow copy of the config register, one per possible device. The OS bit
+ * is not cached, it reads back as the conversion status.
+ */
+typedef struct
+{
+    uint16_t config;
+    bool valid;
+    uint32_t transactions;
+} ads111x_state_t;
+
+static ads111x_state_t states[I2C_NUM_MAX][4];
+
+static inline ads111x_state_t *get_state(const i2c_dev_t *dev)
+{
+    return &states[dev->port][dev->addr - ADS111X_ADDR_GND];
+}
+
 static esp_err_t read_reg(i2c_dev_t *dev, uint8_t reg, uint16_t *val)
 {
     uint8_t buf[2];
     esp_err_t res;
+    get_state(dev)->transactions++;
     if ((res = i2c_dev_read_reg(dev, reg, buf, 2)) != ESP_OK)
     {
         ESP_LOGE(TAG, "Could not read from register 0x%02x", reg);
@@ -74,6 +96,7 @@ static esp_err_t write_reg(i2c_dev_t *dev, uint8_t reg, uint16_t val)
 {
     uint8_t buf[2] = { val >> 8, val };
     esp_err_t res;
+    get_state(dev)->transactions++;
     if ((res = i2c_dev_write_reg(dev, reg, buf, 2)) != ESP_OK)
     {
         ESP_LOGE(TAG, "Could not write 0x%04x to register 0x%02x", val, reg);
@@ -83,6 +106,38 @@ static esp_err_t write_reg(i2c_dev_t *dev, uint8_t reg, uint16_t val)
     return ESP_OK;
 }
 
+static esp_err_t read_config(i2c_dev_t *dev, uint16_t *val)
+{
+    ads111x_state_t *state = get_state(dev);
+    esp_err_t res;
+
+    if ((res = read_reg(dev, REG_CONFIG, val)) != ESP_OK)
+        return res;
+
+    state->config = *val & CONFIG_CACHE_MASK;
+    state->valid = true;
+
+    return ESP_OK;
+}
+
+static esp_err_t write_config(i2c_dev_t *dev, uint16_t val)
+{
+    ads111x_state_t *state = get_state(dev);
+    esp_err_t res;
+
+    if ((res = write_reg(dev, REG_CONFIG, val)) != ESP_OK)
+    {
+        // Register contents are unknown now, read them back next time
+        state->valid = false;
+        return res;
+    }
+
+    state->config = val & CONFIG_CACHE_MASK;
+    state->valid = true;
+
+    return ESP_OK;
+}
+
 static esp_err_t read_conf_bits(i2c_dev_t *dev, uint8_t offs, uint16_t mask,
         uint16_t *bits)
 {
@@ -91,7 +146,10 @@ static esp_err_t read_conf_bits(i2c_dev_t *dev, uint8_t offs, uint16_t mask,
     uint16_t val;
 
     I2C_DEV_TAKE_MUTEX(dev);
-    I2C_DEV_CHECK(dev, read_reg(dev, REG_CONFIG, &val));
+    if (offs == OS_OFFSET || !get_state(dev)->valid)
+        I2C_DEV_CHECK(dev, read_config(dev, &val));
+    else
+        val = get_state(dev)->config;
     I2C_DEV_GIVE_MUTEX(dev);
 
     ESP_LOGD(TAG, "Got config value: 0x%04x", val);
@@ -109,8 +167,11 @@ static esp_err_t write_conf_bits(i2c_dev_t *dev, uint16_t val, uint8_t offs,
     uint16_t old;
 
     I2C_DEV_TAKE_MUTEX(dev);
-    I2C_DEV_CHECK(dev, read_reg(dev, REG_CONFIG, &old));
-    I2C_DEV_CHECK(dev, write_reg(dev, REG_CONFIG, (old & ~(mask << offs)) | (val << offs)));
+    if (get_state(dev)->valid)
+        old = get_state(dev)->config;
+    else
+        I2C_DEV_CHECK(dev, read_config(dev, &old));
+    I2C_DEV_CHECK(dev, write_config(dev, (old & CONFIG_CACHE_MASK & ~(mask << offs)) | (val << offs)));
     I2C_DEV_GIVE_MUTEX(dev);
 
     return ESP_OK;
@@ -139,8 +200,12 @@ esp_err_t ads111x_init_desc(i2c_dev_t *dev, uint8_t addr, i2c_port_t port,
         return ESP_ERR_INVALID_ARG;
     }
 
+    if (port >= I2C_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+
     dev->port = port;
     dev->addr = addr;
+    memset(get_state(dev), 0, sizeof(ads111x_state_t));
     dev->cfg.sda_io_num = sda_gpio;
     dev->cfg.scl_io_num = scl_gpio;
 #if HELPER_TARGET_IS_ESP32
@@ -158,7 +223,14 @@ esp_err_t ads111x_free_desc(i2c_dev_t *dev)
 
 esp_err_t ads111x_is_busy(i2c_dev_t *dev, bool *busy)
 {
-    READ_CONFIG(OS_OFFSET, OS_MASK, busy);
+    CHECK_ARG(busy);
+
+    uint16_t bits;
+    CHECK(read_conf_bits(dev, OS_OFFSET, OS_MASK, &bits));
+    // OS reads 1 when the device is not performing a conversion
+    *busy = !bits;
+
+    return ESP_OK;
 }
 
 esp_err_t ads111x_start_conversion(i2c_dev_t *dev)
@@ -166,6 +238,37 @@ esp_err_t ads111x_start_conversion(i2c_dev_t *dev)
     return write_conf_bits(dev, 1, OS_OFFSET, OS_MASK);
 }
 
+esp_err_t ads111x_set_input(i2c_dev_t *dev, ads111x_mux_t mux,
+        ads111x_gain_t gain, bool start)
+{
+    CHECK_ARG(dev);
+
+    uint16_t old;
+    uint16_t val;
+
+    I2C_DEV_TAKE_MUTEX(dev);
+    if (get_state(dev)->valid)
+        old = get_state(dev)->config;
+    else
+        I2C_DEV_CHECK(dev, read_config(dev, &old));
+    val = old & CONFIG_CACHE_MASK & ~((MUX_MASK << MUX_OFFSET) | (PGA_MASK << PGA_OFFSET));
+    val |= (mux << MUX_OFFSET) | (gain << PGA_OFFSET);
+    if (start)
+        val |= 1 << OS_OFFSET;
+    I2C_DEV_CHECK(dev, write_config(dev, val));
+    I2C_DEV_GIVE_MUTEX(dev);
+
+    return ESP_OK;
+}
+
+uint32_t ads111x_get_transactions(i2c_dev_t *dev)
+{
+    if (!dev || dev->port >= I2C_NUM_MAX)
+        return 0;
+
+    return get_state(dev)->transactions;
+}
+
 esp_err_t ads111x_get_value(i2c_dev_t *dev, int16_t *value)
 {
     CHECK_ARG(dev && value);
@@ -177,6 +280,37 @@ esp_err_t ads111x_get_value(i2c_dev_t *dev, int16_t *value)
     return ESP_OK;
 }
 
+esp_err_t ads111x_get_value_async(i2c_dev_t *dev, ads111x_read_t *rd)
+{
+    CHECK_ARG(dev && rd);
+
+    memset(&rd->req, 0, sizeof(i2cdev_req_t));
+    rd->reg = REG_CONVERSION;
+    rd->req.dev = dev;
+    rd->req.out = &rd->reg;
+    rd->req.out_size = 1;
+    rd->req.in = rd->buf;
+    rd->req.in_size = 2;
+    get_state(dev)->transactions++;
+
+    return i2cdev_submit(&rd->req);
+}
+
+esp_err_t ads111x_get_value_wait(ads111x_read_t *rd, int16_t *value)
+{
+    CHECK_ARG(rd && value);
+
+    esp_err_t res = i2cdev_wait(&rd->req, portMAX_DELAY);
+    if (res != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Could not read from register 0x%02x", REG_CONVERSION);
+        return res;
+    }
+    *value = (rd->buf[0] << 8) | rd->buf[1];
+
+    return ESP_OK;
+}
+
 esp_err_t ads101x_get_value(i2c_dev_t *dev, int16_t *value)
 {
     CHECK_ARG(dev && value);
@@ -274,6 +408,57 @@ esp_err_t ads111x_set_comp_queue(i2c_dev_t *dev, ads111x_comp_queue_t queue)
     return write_conf_bits(dev, queue, COMP_QUE_OFFSET, COMP_QUE_MASK);
 }
 
+esp_err_t ads111x_set_comp(i2c_dev_t *dev, ads111x_comp_mode_t mode, int16_t th,
+        int16_t *value)
+{
+    CHECK_ARG(dev);
+
+    ads111x_state_t *state = get_state(dev);
+    uint16_t old, val;
+    uint8_t cfg[3], thresh[3] = { REG_THRESH_H, (uint16_t)th >> 8, th };
+    uint8_t reg = REG_CONVERSION, buf[2];
+    i2cdev_seg_t segs[3] = {
+        { .out = cfg, .out_size = 3 },
+        { .out = thresh, .out_size = 3 },
+        { .out = &reg, .out_size = 1, .in = buf, .in_size = 2 },
+    };
+    esp_err_t res;
+
+    I2C_DEV_TAKE_MUTEX(dev);
+    if (state->valid)
+        old = state->config;
+    else
+        I2C_DEV_CHECK(dev, read_config(dev, &old));
+    val = (old & CONFIG_CACHE_MASK & ~(COMP_MODE_MASK << COMP_MODE_OFFSET)) | (mode << COMP_MODE_OFFSET);
+    cfg[0] = REG_CONFIG;
+    cfg[1] = val >> 8;
+    cfg[2] = val;
+
+    if (mode == ADS111X_COMP_MODE_NORMAL)
+    {
+        segs[0].out = thresh;
+        segs[1].out = cfg;
+    }
+
+    state->transactions++;
+    if ((res = i2c_dev_batch(dev, segs, value ? 3 : 2)) != ESP_OK)
+    {
+        // Register contents are unknown now, read them back next time
+        state->valid = false;
+        I2C_DEV_GIVE_MUTEX(dev);
+        ESP_LOGE(TAG, "Could not set comparator mode %d, threshold %d", mode, th);
+        return res;
+    }
+    state->config = val & CONFIG_CACHE_MASK;
+    state->valid = true;
+    I2C_DEV_GIVE_MUTEX(dev);
+
+    if (value)
+        *value = (buf[0] << 8) | buf[1];
+
+    return ESP_OK;
+}
+
 esp_err_t ads111x_get_comp_low_thresh(i2c_dev_t *dev, int16_t *th)
 {
     CHECK_ARG(dev && th);
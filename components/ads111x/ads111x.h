@@ -177,6 +177,29 @@ esp_err_t ads111x_is_busy(i2c_dev_t *dev, bool *busy);
  */
 esp_err_t ads111x_start_conversion(i2c_dev_t *dev);
 
+/**
+ * @brief Set input multiplexer and gain, optionally starting a conversion
+ *
+ * All fields are merged into a single config register write. The config
+ * register is cached by the driver, so no read is issued once it is known.
+ *
+ * @param dev Device descriptor
+ * @param mux Input multiplexer configuration
+ * @param gain Gain value
+ * @param start Begin a single conversion (single-shot mode only)
+ * @return `ESP_OK` on success
+ */
+esp_err_t ads111x_set_input(i2c_dev_t *dev, ads111x_mux_t mux,
+        ads111x_gain_t gain, bool start);
+
+/**
+ * @brief Get the number of I2C transactions issued to the device
+ *
+ * @param dev Device descriptor
+ * @return Number of register reads and writes since ::ads111x_init_desc()
+ */
+uint32_t ads111x_get_transactions(i2c_dev_t *dev);
+
 /**
  * @brief Read last conversion result
  *
@@ -186,6 +209,39 @@ esp_err_t ads111x_start_conversion(i2c_dev_t *dev);
  */
 esp_err_t ads111x_get_value(i2c_dev_t *dev, int16_t *value);
 
+/**
+ * Asynchronous conversion result read, see ::ads111x_get_value_async()
+ */
+typedef struct
+{
+    i2cdev_req_t req;
+    uint8_t reg;
+    uint8_t buf[2];
+} ads111x_read_t;
+
+/**
+ * @brief Queue a read of the last conversion result without waiting
+ *
+ * The read is a single transaction which leaves the cached configuration
+ * alone, so the device mutex is not taken. \p rd belongs to the bus until
+ * ::ads111x_get_value_wait() returns, which must be called from the same
+ * task.
+ *
+ * @param dev Device descriptor
+ * @param rd Read request
+ * @return `ESP_OK` if the read was queued
+ */
+esp_err_t ads111x_get_value_async(i2c_dev_t *dev, ads111x_read_t *rd);
+
+/**
+ * @brief Wait for a read queued by ::ads111x_get_value_async()
+ *
+ * @param rd Read request
+ * @param[out] value Last conversion result
+ * @return `ESP_OK` on success
+ */
+esp_err_t ads111x_get_value_wait(ads111x_read_t *rd, int16_t *value);
+
 /**
  * @brief Read last conversion result for ADS101x
  *
@@ -402,6 +458,24 @@ esp_err_t ads111x_get_comp_high_thresh(i2c_dev_t *dev, int16_t *th);
  */
 esp_err_t ads111x_set_comp_high_thresh(i2c_dev_t *dev, int16_t th);
 
+/**
+ * @brief Switch the comparator mode and upper threshold in one transaction
+ *
+ * ADS1114 and ADS1115 only.
+ * The config and upper threshold writes are chained with repeated starts,
+ * followed by a read of the last conversion result when \p value is
+ * non-null, see ::i2c_dev_batch(). Going to the window comparator the config
+ * is written first, back to the traditional one the threshold is.
+ *
+ * @param dev Device descriptor
+ * @param mode Comparator mode
+ * @param th Upper threshold value
+ * @param[out] value Last conversion result, read after the writes if non-null
+ * @return `ESP_OK` on success
+ */
+esp_err_t ads111x_set_comp(i2c_dev_t *dev, ads111x_comp_mode_t mode, int16_t th,
+        int16_t *value);
+
 #ifdef __cplusplus
 }
 #endif
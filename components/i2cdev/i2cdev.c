@@ -10,19 +10,73 @@
 #include <string.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/queue.h>
 #include <esp_log.h>
+#include <driver/gpio.h>
+#include <rom/ets_sys.h>
+#include <esp_timer.h>
 #include "i2cdev.h"
 
+// Bus recovery, ~100kHz SCL
+#define RECOVERY_SCL_PULSES   9
+#define RECOVERY_HALF_CLK_US  5
+
 static const char *TAG = "i2cdev";
 
+// Command link built once and replayed, it points into buf. A plain
+// transaction is a single segment.
+typedef struct {
+    i2c_cmd_handle_t cmd;
+    uint8_t addr;
+    uint8_t seg_count;
+    uint16_t out_size[I2CDEV_SEGS_MAX];
+    uint16_t in_size[I2CDEV_SEGS_MAX];
+    uint32_t stamp;
+    uint8_t buf[CONFIG_I2CDEV_CMD_BUF_SIZE];
+} cmd_slot_t;
+
 typedef struct {
     SemaphoreHandle_t lock;
     i2c_config_t config;
     bool installed;
+    cmd_slot_t pool[CONFIG_I2CDEV_CMD_POOL_SIZE];
+    uint32_t stamp;
+    i2cdev_cmd_stats_t cmd_stats;
+    i2cdev_dev_stats_t dev_stats[CONFIG_I2CDEV_STATS_DEVS];
+    int dev_stats_count;
+    uint32_t timeouts;       // Consecutive ones
+    bool stuck;              // Last recovery failed
+    int64_t stuck_retry;     // Next recovery attempt, esp_timer time
+    i2cdev_bus_stats_t bus_stats;
 } i2c_port_state_t;
 
 static i2c_port_state_t states[I2C_NUM_MAX];
 
+static esp_err_t recover_locked(i2c_port_t port);
+
+#ifdef CONFIG_I2CDEV_ARBITER
+#define ARBITER_STACK_SIZE    2048
+
+// One FIFO per priority, the high one drained first, keeps the order of
+// the requests of a priority. Every queued request gives arbiter_pending.
+static QueueHandle_t arbiter_queue;
+static QueueHandle_t arbiter_queue_high;
+static SemaphoreHandle_t arbiter_pending;
+static TaskHandle_t arbiter_handle;
+
+static void arbiter_delete(void)
+{
+    if (arbiter_queue) vQueueDelete(arbiter_queue);
+    if (arbiter_queue_high) vQueueDelete(arbiter_queue_high);
+    if (arbiter_pending) vSemaphoreDelete(arbiter_pending);
+    arbiter_queue = NULL;
+    arbiter_queue_high = NULL;
+    arbiter_pending = NULL;
+}
+
+static void arbiter_task(void *arg);
+#endif
+
 #define SEMAPHORE_TAKE(port) do { \
         if (!xSemaphoreTake(states[port].lock, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT))) \
         { \
@@ -53,22 +107,57 @@ esp_err_t i2cdev_init()
         }
     }
 
+#ifdef CONFIG_I2CDEV_ARBITER
+    arbiter_queue = xQueueCreate(CONFIG_I2CDEV_ARBITER_QUEUE_LEN, sizeof(i2cdev_req_t *));
+    arbiter_queue_high = xQueueCreate(CONFIG_I2CDEV_ARBITER_QUEUE_LEN, sizeof(i2cdev_req_t *));
+    arbiter_pending = xSemaphoreCreateCounting(2 * CONFIG_I2CDEV_ARBITER_QUEUE_LEN, 0);
+    if (!arbiter_queue || !arbiter_queue_high || !arbiter_pending)
+    {
+        ESP_LOGE(TAG, "Could not create arbiter queues");
+        arbiter_delete();
+        return ESP_FAIL;
+    }
+
+    if (xTaskCreate(arbiter_task, "i2c_arbiter", ARBITER_STACK_SIZE, NULL,
+            CONFIG_I2CDEV_ARBITER_PRIORITY, &arbiter_handle) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Could not create arbiter task");
+        arbiter_delete();
+        return ESP_FAIL;
+    }
+#endif
+
     return ESP_OK;
 }
 
 esp_err_t i2cdev_done()
 {
+#ifdef CONFIG_I2CDEV_ARBITER
+    if (arbiter_handle)
+    {
+        vTaskDelete(arbiter_handle);
+        arbiter_handle = NULL;
+        arbiter_delete();
+    }
+#endif
+
     for (int i = 0; i < I2C_NUM_MAX; i++)
     {
         if (!states[i].lock) continue;
 
+        SEMAPHORE_TAKE(i);
         if (states[i].installed)
         {
-            SEMAPHORE_TAKE(i);
             i2c_driver_delete(i);
             states[i].installed = false;
-            SEMAPHORE_GIVE(i);
         }
+        for (int j = 0; j < CONFIG_I2CDEV_CMD_POOL_SIZE; j++)
+        {
+            if (states[i].pool[j].cmd)
+                i2c_cmd_link_delete(states[i].pool[j].cmd);
+            states[i].pool[j].cmd = NULL;
+        }
+        SEMAPHORE_GIVE(i);
         vSemaphoreDelete(states[i].lock);
         states[i].lock = NULL;
     }
@@ -142,17 +231,33 @@ inline static bool cfg_equal(const i2c_config_t *a, const i2c_config_t *b)
         && a->sda_pullup_en == b->sda_pullup_en;
 }
 
+// Device setting, or the Kconfig default when 0
+uint32_t i2c_dev_get_stretch_tick(const i2c_dev_t *dev)
+{
+    if (dev->timeout_ticks)
+        return dev->timeout_ticks;
+
+    return CONFIG_I2CDEV_CLK_STRETCH_TICK ? CONFIG_I2CDEV_CLK_STRETCH_TICK : I2CDEV_MAX_STRETCH_TIME;
+}
+
 static esp_err_t i2c_setup_port(const i2c_dev_t *dev)
 {
     if (dev->port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
 
     esp_err_t res;
-    if (!cfg_equal(&dev->cfg, &states[dev->port].config))
-    {
-        i2c_config_t temp;
-        memcpy(&temp, &dev->cfg, sizeof(i2c_config_t));
-        temp.mode = I2C_MODE_MASTER;
+    i2c_config_t temp;
+    memcpy(&temp, &dev->cfg, sizeof(i2c_config_t));
+    temp.mode = I2C_MODE_MASTER;
+#if HELPER_TARGET_IS_ESP32
+    if (!temp.master.clk_speed)
+        temp.master.clk_speed = CONFIG_I2CDEV_CLK_SPEED_HZ;
+#elif HELPER_TARGET_IS_ESP8266 && HELPER_TARGET_VERSION > HELPER_TARGET_VERSION_ESP8266_V3_2
+    // Clock Stretch time, depending on CPU frequency
+    temp.clk_stretch_tick = i2c_dev_get_stretch_tick(dev);
+#endif
 
+    if (!cfg_equal(&temp, &states[dev->port].config))
+    {
         // Driver reinstallation
         if (states[dev->port].installed)
             i2c_driver_delete(dev->port);
@@ -163,10 +268,6 @@ static esp_err_t i2c_setup_port(const i2c_dev_t *dev)
             return res;
 #endif
 #if HELPER_TARGET_IS_ESP8266
-#if HELPER_TARGET_VERSION > HELPER_TARGET_VERSION_ESP8266_V3_2
-        // Clock Stretch time, depending on CPU frequency
-        temp.clk_stretch_tick = dev->timeout_ticks ? dev->timeout_ticks : I2CDEV_MAX_STRETCH_TIME;
-#endif
         if ((res = i2c_driver_install(dev->port, temp.mode)) != ESP_OK)
             return res;
         if ((res = i2c_param_config(dev->port, &temp)) != ESP_OK)
@@ -181,7 +282,7 @@ static esp_err_t i2c_setup_port(const i2c_dev_t *dev)
     if ((res = i2c_get_timeout(dev->port, &t)) != ESP_OK)
         return res;
     // Timeout cannot be 0
-    uint32_t ticks = dev->timeout_ticks ? dev->timeout_ticks : I2CDEV_MAX_STRETCH_TIME;
+    uint32_t ticks = i2c_dev_get_stretch_tick(dev);
     if ((ticks != t) && (res = i2c_set_timeout(dev->port, ticks)) != ESP_OK)
         return res;
     ESP_LOGD(TAG, "Timeout: ticks = %d (%d usec) on port %d", dev->timeout_ticks, dev->timeout_ticks / 80, dev->port);
@@ -190,64 +291,590 @@ static esp_err_t i2c_setup_port(const i2c_dev_t *dev)
     return ESP_OK;
 }
 
-esp_err_t i2c_dev_read(const i2c_dev_t *dev, const void *out_data, size_t out_size, void *in_data, size_t in_size)
+static i2c_cmd_handle_t cmd_build(uint8_t addr, const void *reg, size_t reg_size,
+        const void *out, size_t out_size, void *in, size_t in_size)
 {
-    if (!dev || !in_data || !in_size) return ESP_ERR_INVALID_ARG;
-    
-    SEMAPHORE_TAKE(dev->port);
-    
-    esp_err_t res = i2c_setup_port(dev);
-    if (res == ESP_OK)
-    {        
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        if (out_data && out_size)
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    if (!cmd) return NULL;
+
+    if (reg_size || out_size)
+    {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, addr << 1, true);
+        if (reg_size)
+            i2c_master_write(cmd, (void *)reg, reg_size, true);
+        if (out_size)
+            i2c_master_write(cmd, (void *)out, out_size, true);
+    }
+    if (in_size)
+    {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (addr << 1) | 1, true);
+        i2c_master_read(cmd, in, in_size, I2C_MASTER_LAST_NACK);
+    }
+    i2c_master_stop(cmd);
+
+    return cmd;
+}
+
+// Segments chained with repeated starts, a single stop at the end
+static i2c_cmd_handle_t cmd_build_segs(uint8_t addr, const i2cdev_seg_t *segs, size_t count)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    if (!cmd) return NULL;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (segs[i].out_size)
         {
             i2c_master_start(cmd);
-            i2c_master_write_byte(cmd, dev->addr << 1, true);
-            i2c_master_write(cmd, (void *)out_data, out_size, true);
+            i2c_master_write_byte(cmd, addr << 1, true);
+            i2c_master_write(cmd, (void *)segs[i].out, segs[i].out_size, true);
         }
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (dev->addr << 1) | 1, true);
-        i2c_master_read(cmd, in_data, in_size, I2C_MASTER_LAST_NACK);
-        i2c_master_stop(cmd);
+        if (segs[i].in_size)
+        {
+            i2c_master_start(cmd);
+            i2c_master_write_byte(cmd, (addr << 1) | 1, true);
+            i2c_master_read(cmd, segs[i].in, segs[i].in_size, I2C_MASTER_LAST_NACK);
+        }
+    }
+    i2c_master_stop(cmd);
 
-        res = i2c_master_cmd_begin(dev->port, cmd, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT));
-        if (res != ESP_OK)
-            ESP_LOGE(TAG, "Could not read from device [0x%02x at %d]: %d", dev->addr, dev->port, res);
+    return cmd;
+}
 
-        i2c_cmd_link_delete(cmd);
+// Port mutex must be taken. The driver only walks the command list, so a
+// link is replayed for every transaction of the same address and segment
+// sizes, the least recently used one is rebuilt for a new shape.
+static cmd_slot_t *cmd_slot_get(i2c_port_t port, uint8_t addr, const i2cdev_seg_t *segs, size_t count)
+{
+    i2c_port_state_t *st = &states[port];
+    cmd_slot_t *slot, *victim = NULL;
+    i2cdev_seg_t shape[I2CDEV_SEGS_MAX];
+    size_t total = 0, i;
+    uint8_t *p;
+
+    for (i = 0; i < count; i++)
+        total += segs[i].out_size + segs[i].in_size;
+    if (total > CONFIG_I2CDEV_CMD_BUF_SIZE)
+        return NULL;
+
+    for (int j = 0; j < CONFIG_I2CDEV_CMD_POOL_SIZE; j++)
+    {
+        slot = &st->pool[j];
+        if (slot->cmd && slot->addr == addr && slot->seg_count == count)
+        {
+            for (i = 0; i < count; i++)
+                if (slot->out_size[i] != segs[i].out_size || slot->in_size[i] != segs[i].in_size)
+                    break;
+            if (i == count)
+            {
+                slot->stamp = ++st->stamp;
+                st->cmd_stats.reuses++;
+                return slot;
+            }
+        }
+        if (!victim || (victim->cmd && (!slot->cmd || slot->stamp < victim->stamp)))
+            victim = slot;
+    }
+
+    // Every segment gets its data, then its input, in turn in the buffer
+    p = victim->buf;
+    for (i = 0; i < count; i++)
+    {
+        shape[i].out = p;
+        shape[i].out_size = segs[i].out_size;
+        p += segs[i].out_size;
+        shape[i].in = p;
+        shape[i].in_size = segs[i].in_size;
+        p += segs[i].in_size;
     }
 
-    SEMAPHORE_GIVE(dev->port);
+    if (victim->cmd)
+        i2c_cmd_link_delete(victim->cmd);
+    victim->cmd = cmd_build_segs(addr, shape, count);
+    if (!victim->cmd)
+        return NULL;
+    st->cmd_stats.allocs++;
+
+    victim->addr = addr;
+    victim->seg_count = count;
+    for (i = 0; i < count; i++)
+    {
+        victim->out_size[i] = segs[i].out_size;
+        victim->in_size[i] = segs[i].in_size;
+    }
+    victim->stamp = ++st->stamp;
+
+    return victim;
+}
+
+// Port mutex must be taken
+static esp_err_t transfer(i2c_port_t port, uint8_t addr, const void *reg, size_t reg_size,
+        const void *out, size_t out_size, void *in, size_t in_size)
+{
+    i2cdev_seg_t seg = { .out_size = reg_size + out_size, .in_size = in_size };
+    cmd_slot_t *slot = cmd_slot_get(port, addr, &seg, 1);
+    i2c_cmd_handle_t cmd;
+    esp_err_t res;
+
+    if (slot)
+    {
+        if (reg_size)
+            memcpy(slot->buf, reg, reg_size);
+        if (out_size)
+            memcpy(slot->buf + reg_size, out, out_size);
+        cmd = slot->cmd;
+    }
+    else
+    {
+        // Larger than the pool buffers or out of memory, one shot link
+        cmd = cmd_build(addr, reg, reg_size, out, out_size, in, in_size);
+        if (!cmd) return ESP_ERR_NO_MEM;
+        states[port].cmd_stats.allocs++;
+        states[port].cmd_stats.unpooled++;
+    }
+
+    res = i2c_master_cmd_begin(port, cmd, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT));
+
+    if (!slot)
+        i2c_cmd_link_delete(cmd);
+    else if (res == ESP_OK && in_size)
+        memcpy(in, slot->buf + reg_size + out_size, in_size);
+
     return res;
 }
 
-esp_err_t i2c_dev_write(const i2c_dev_t *dev, const void *out_reg, size_t out_reg_size, const void *out_data, size_t out_size)
+// Port mutex must be taken
+static esp_err_t transfer_segs(i2c_port_t port, uint8_t addr, const i2cdev_seg_t *segs, size_t count)
 {
-    if (!dev || !out_data || !out_size) return ESP_ERR_INVALID_ARG;
+    cmd_slot_t *slot = cmd_slot_get(port, addr, segs, count);
+    i2c_cmd_handle_t cmd;
+    esp_err_t res;
+    uint8_t *p;
+    size_t i;
+
+    if (slot)
+    {
+        p = slot->buf;
+        for (i = 0; i < count; i++)
+        {
+            if (segs[i].out_size)
+                memcpy(p, segs[i].out, segs[i].out_size);
+            p += segs[i].out_size + segs[i].in_size;
+        }
+        cmd = slot->cmd;
+    }
+    else
+    {
+        cmd = cmd_build_segs(addr, segs, count);
+        if (!cmd) return ESP_ERR_NO_MEM;
+        states[port].cmd_stats.allocs++;
+        states[port].cmd_stats.unpooled++;
+    }
+
+    res = i2c_master_cmd_begin(port, cmd, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT));
+
+    if (!slot)
+    {
+        i2c_cmd_link_delete(cmd);
+        return res;
+    }
+    if (res != ESP_OK)
+        return res;
+
+    p = slot->buf;
+    for (i = 0; i < count; i++)
+    {
+        p += segs[i].out_size;
+        if (segs[i].in_size)
+            memcpy(segs[i].in, p, segs[i].in_size);
+        p += segs[i].in_size;
+    }
+
+    return ESP_OK;
+}
+
+static size_t req_bytes(const i2cdev_req_t *req)
+{
+    size_t bytes = 0;
 
-    SEMAPHORE_TAKE(dev->port);
+    if (!req->segs)
+        return req->reg_size + req->out_size + req->in_size;
+
+    for (size_t i = 0; i < req->seg_count; i++)
+        bytes += req->segs[i].out_size + req->segs[i].in_size;
+
+    return bytes;
+}
+
+// Port mutex must be taken
+static void dev_stats_add(const i2cdev_req_t *req, esp_err_t res, int64_t start, int64_t end)
+{
+    i2c_port_state_t *st = &states[req->port];
+    i2cdev_dev_stats_t *ds = NULL;
+    uint32_t lat = end - start;
+    uint32_t wait = start - req->submitted;
+    int bucket;
+
+    for (int i = 0; i < st->dev_stats_count; i++)
+    {
+        if (st->dev_stats[i].addr == req->addr)
+        {
+            ds = &st->dev_stats[i];
+            break;
+        }
+    }
+    if (!ds)
+    {
+        // Devices past the table size are not counted
+        if (st->dev_stats_count >= CONFIG_I2CDEV_STATS_DEVS)
+            return;
+        ds = &st->dev_stats[st->dev_stats_count++];
+        memset(ds, 0, sizeof(i2cdev_dev_stats_t));
+        ds->addr = req->addr;
+    }
+
+    ds->transactions++;
+    switch (res)
+    {
+        case ESP_OK:
+            ds->bytes += req_bytes(req);
+            break;
+        case ESP_FAIL:
+            ds->err_nack++;
+            break;
+        case ESP_ERR_TIMEOUT:
+            ds->err_timeout++;
+            break;
+        default:
+            ds->err_other++;
+            break;
+    }
 
-    esp_err_t res = i2c_setup_port(dev);
+    ds->busy_us += lat;
+    ds->wait_us += wait;
+    if (wait > ds->wait_max_us)
+        ds->wait_max_us = wait;
+
+    bucket = lat ? 31 - __builtin_clz(lat) : 0;
+    if (bucket >= I2CDEV_LAT_BUCKETS)
+        bucket = I2CDEV_LAT_BUCKETS - 1;
+    ds->lat_hist[bucket]++;
+}
+
+// Port mutex must be taken. Returns ESP_OK if the bus can be used.
+static esp_err_t check_stuck(i2c_port_t port, int64_t now)
+{
+    i2c_port_state_t *st = &states[port];
+
+    if (!st->stuck)
+        return ESP_OK;
+
+    // Fail fast instead of a timeout per transaction
+    if (now < st->stuck_retry)
+    {
+        st->bus_stats.fast_fails++;
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return recover_locked(port) == ESP_OK ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+// Port mutex must be taken
+static void count_timeout(i2c_port_t port, esp_err_t res)
+{
+    i2c_port_state_t *st = &states[port];
+
+    if (res != ESP_ERR_TIMEOUT)
+    {
+        if (res == ESP_OK)
+            st->timeouts = 0;
+        return;
+    }
+
+    if (++st->timeouts < CONFIG_I2CDEV_STUCK_TIMEOUTS)
+        return;
+
+    ESP_LOGE(TAG, "Bus stuck on port %d, %d timeouts", port, st->timeouts);
+    st->timeouts = 0;
+    recover_locked(port);
+}
+
+// Takes the port mutex, from the arbiter task when it runs
+static esp_err_t run_req(i2cdev_req_t *req)
+{
+    SEMAPHORE_TAKE(req->port);
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t res = check_stuck(req->port, start);
     if (res == ESP_OK)
     {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, dev->addr << 1, true);
-        if (out_reg && out_reg_size)
-            i2c_master_write(cmd, (void *)out_reg, out_reg_size, true);
-        i2c_master_write(cmd, (void *)out_data, out_size, true);
-        i2c_master_stop(cmd);
-        res = i2c_master_cmd_begin(dev->port, cmd, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT));
+        if (req->dev)
+            res = i2c_setup_port(req->dev);
+        else
+            res = states[req->port].installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    }
+
+    if (res == ESP_OK)
+    {
+        int64_t t = esp_timer_get_time();
+        if (req->segs)
+            res = transfer_segs(req->port, req->addr, req->segs, req->seg_count);
+        else
+            res = transfer(req->port, req->addr, req->reg, req->reg_size,
+                           req->out, req->out_size, req->in, req->in_size);
+        req->bus_us = esp_timer_get_time() - t;
         if (res != ESP_OK)
-            ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d", dev->addr, dev->port, res);
-        i2c_cmd_link_delete(cmd);
+            ESP_LOGE(TAG, "Could not %s device [0x%02x at %d]: %d",
+                     req->segs ? "run batch on" : req->in_size ? "read from" : "write to",
+                     req->addr, req->port, res);
+        count_timeout(req->port, res);
     }
+    if (!req->bench)
+        dev_stats_add(req, res, start, esp_timer_get_time());
 
-    SEMAPHORE_GIVE(dev->port);
+    SEMAPHORE_GIVE(req->port);
     return res;
 }
 
+// The request is released by done, the owner may reuse it right after
+static void complete(i2cdev_req_t *req, esp_err_t res)
+{
+    TaskHandle_t task = req->task;
+
+    req->res = res;
+    if (req->cb)
+    {
+        req->cb(req);
+        req->done = true;
+        return;
+    }
+
+    req->done = true;
+    if (task)
+        xTaskNotifyGive(task);
+}
+
+#ifdef CONFIG_I2CDEV_ARBITER
+static void arbiter_task(void *arg)
+{
+    i2cdev_req_t *req;
+
+    while (1)
+    {
+        if (xSemaphoreTake(arbiter_pending, portMAX_DELAY) != pdTRUE)
+            continue;
+        if (xQueueReceive(arbiter_queue_high, &req, 0) != pdTRUE &&
+            xQueueReceive(arbiter_queue, &req, 0) != pdTRUE)
+            continue;
+
+        complete(req, run_req(req));
+    }
+}
+#endif
+
+esp_err_t i2cdev_submit(i2cdev_req_t *req)
+{
+    if (!req) return ESP_ERR_INVALID_ARG;
+    if (req->dev)
+    {
+        req->port = req->dev->port;
+        req->addr = req->dev->addr;
+        req->prio = req->dev->prio;
+    }
+    if (req->port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    if (req->segs)
+    {
+        if (!req->seg_count || req->seg_count > I2CDEV_SEGS_MAX) return ESP_ERR_INVALID_ARG;
+        for (size_t i = 0; i < req->seg_count; i++)
+        {
+            if ((!req->segs[i].out || !req->segs[i].out_size) &&
+                (!req->segs[i].in || !req->segs[i].in_size))
+                return ESP_ERR_INVALID_ARG;
+            if ((!req->segs[i].out && req->segs[i].out_size) ||
+                (!req->segs[i].in && req->segs[i].in_size))
+                return ESP_ERR_INVALID_ARG;
+        }
+    }
+    else
+    {
+        if (!req->reg) req->reg_size = 0;
+        if (!req->out) req->out_size = 0;
+        if (!req->in) req->in_size = 0;
+        if (!req->reg_size && !req->out_size && !req->in_size) return ESP_ERR_INVALID_ARG;
+    }
+
+    req->done = false;
+    req->res = ESP_FAIL;
+    req->task = xTaskGetCurrentTaskHandle();
+    req->submitted = esp_timer_get_time();
+
+#ifdef CONFIG_I2CDEV_ARBITER
+    // From a completion callback the transaction runs right away
+    if (arbiter_queue && req->task != arbiter_handle)
+    {
+        BaseType_t queued;
+
+        // Urgent transfers go ahead of every queued display chunk, in order
+        queued = xQueueSend(req->prio == I2CDEV_PRIO_HIGH ? arbiter_queue_high : arbiter_queue,
+                            &req, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT));
+        if (queued != pdTRUE)
+        {
+            ESP_LOGE(TAG, "Could not queue transaction on port %d", req->port);
+            return ESP_ERR_TIMEOUT;
+        }
+        xSemaphoreGive(arbiter_pending);
+        return ESP_OK;
+    }
+#endif
+    complete(req, run_req(req));
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_wait(i2cdev_req_t *req, TickType_t wait)
+{
+    if (!req || req->cb) return ESP_ERR_INVALID_ARG;
+
+    TickType_t start = xTaskGetTickCount();
+    TickType_t spent;
+
+    // The notification may be for another request of this task, or this
+    // one may have been taken by an earlier wait
+    while (!req->done)
+    {
+        spent = xTaskGetTickCount() - start;
+        if (wait != portMAX_DELAY && spent >= wait)
+            return ESP_ERR_TIMEOUT;
+        ulTaskNotifyTake(pdTRUE, wait == portMAX_DELAY ? portMAX_DELAY : wait - spent);
+    }
+
+    return req->res;
+}
+
+// The request lives on the caller stack, so the caller always waits for it
+static esp_err_t submit_wait(i2cdev_req_t *req)
+{
+    esp_err_t res = i2cdev_submit(req);
+    if (res != ESP_OK)
+        return res;
+
+    return i2cdev_wait(req, portMAX_DELAY);
+}
+
+esp_err_t i2c_dev_read(const i2c_dev_t *dev, const void *out_data, size_t out_size, void *in_data, size_t in_size)
+{
+    if (!dev || !in_data || !in_size) return ESP_ERR_INVALID_ARG;
+    if (dev->port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+
+    i2cdev_req_t req = {
+        .dev = dev,
+        .out = out_data,
+        .out_size = out_data ? out_size : 0,
+        .in = in_data,
+        .in_size = in_size,
+    };
+    return submit_wait(&req);
+}
+
+esp_err_t i2c_dev_write(const i2c_dev_t *dev, const void *out_reg, size_t out_reg_size, const void *out_data, size_t out_size)
+{
+    if (!dev || !out_data || !out_size) return ESP_ERR_INVALID_ARG;
+    if (dev->port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+
+    i2cdev_req_t req = {
+        .dev = dev,
+        .reg = out_reg,
+        .reg_size = out_reg ? out_reg_size : 0,
+        .out = out_data,
+        .out_size = out_size,
+    };
+    return submit_wait(&req);
+}
+
+esp_err_t i2cdev_port_write(i2c_port_t port, uint8_t addr, i2cdev_prio_t prio,
+        const void *out_reg, size_t out_reg_size, const void *out_data, size_t out_size)
+{
+    if (port >= I2C_NUM_MAX || !out_data || !out_size) return ESP_ERR_INVALID_ARG;
+
+    i2cdev_req_t req = {
+        .port = port,
+        .addr = addr,
+        .prio = prio,
+        .reg = out_reg,
+        .reg_size = out_reg ? out_reg_size : 0,
+        .out = out_data,
+        .out_size = out_size,
+    };
+    return submit_wait(&req);
+}
+
+esp_err_t i2c_dev_batch(const i2c_dev_t *dev, const i2cdev_seg_t *segs, size_t count)
+{
+    if (!dev || !segs) return ESP_ERR_INVALID_ARG;
+
+    i2cdev_req_t req = {
+        .dev = dev,
+        .segs = segs,
+        .seg_count = count,
+    };
+    return submit_wait(&req);
+}
+
+esp_err_t i2cdev_port_batch(i2c_port_t port, uint8_t addr, i2cdev_prio_t prio,
+        const i2cdev_seg_t *segs, size_t count)
+{
+    if (port >= I2C_NUM_MAX || !segs) return ESP_ERR_INVALID_ARG;
+
+    i2cdev_req_t req = {
+        .port = port,
+        .addr = addr,
+        .prio = prio,
+        .segs = segs,
+        .seg_count = count,
+    };
+    return submit_wait(&req);
+}
+
+esp_err_t i2cdev_get_cmd_stats(i2c_port_t port, i2cdev_cmd_stats_t *stats, bool clear)
+{
+    if (port >= I2C_NUM_MAX || !stats) return ESP_ERR_INVALID_ARG;
+
+    SEMAPHORE_TAKE(port);
+
+    *stats = states[port].cmd_stats;
+    if (clear)
+        memset(&states[port].cmd_stats, 0, sizeof(i2cdev_cmd_stats_t));
+
+    SEMAPHORE_GIVE(port);
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_get_dev_stats(i2c_port_t port, i2cdev_dev_stats_t *stats, int *count, bool clear)
+{
+    if (port >= I2C_NUM_MAX || !stats || !count || *count < 0) return ESP_ERR_INVALID_ARG;
+
+    SEMAPHORE_TAKE(port);
+
+    if (*count > states[port].dev_stats_count)
+        *count = states[port].dev_stats_count;
+    memcpy(stats, states[port].dev_stats, *count * sizeof(i2cdev_dev_stats_t));
+
+    // Keep the devices, a cleared one is reported with zero counters
+    if (clear)
+    {
+        for (int i = 0; i < states[port].dev_stats_count; i++)
+        {
+            uint8_t addr = states[port].dev_stats[i].addr;
+            memset(&states[port].dev_stats[i], 0, sizeof(i2cdev_dev_stats_t));
+            states[port].dev_stats[i].addr = addr;
+        }
+    }
+
+    SEMAPHORE_GIVE(port);
+    return ESP_OK;
+}
+
 esp_err_t i2c_dev_read_reg(const i2c_dev_t *dev, uint8_t reg,
         void *in_data, size_t in_size)
 {
@@ -259,3 +886,244 @@ esp_err_t i2c_dev_write_reg(const i2c_dev_t *dev, uint8_t reg,
 {
     return i2c_dev_write(dev, &reg, 1, out_data, out_size);
 }
+
+// Port mutex must be taken
+static esp_err_t reinstall_port(i2c_port_t port)
+{
+    i2c_config_t *cfg = &states[port].config;
+    esp_err_t res;
+
+    if (states[port].installed)
+        i2c_driver_delete(port);
+    states[port].installed = false;
+
+#if HELPER_TARGET_IS_ESP32
+    if ((res = i2c_param_config(port, cfg)) == ESP_OK)
+        res = i2c_driver_install(port, cfg->mode, 0, 0, 0);
+#endif
+#if HELPER_TARGET_IS_ESP8266
+    if ((res = i2c_driver_install(port, cfg->mode)) == ESP_OK)
+        res = i2c_param_config(port, cfg);
+#endif
+    if (res != ESP_OK)
+    {
+        // Let the next transaction try a full setup
+        memset(cfg, 0, sizeof(i2c_config_t));
+        ESP_LOGE(TAG, "Could not reinstall driver on port %d: %d", port, res);
+        return res;
+    }
+    states[port].installed = true;
+
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_reset_port(i2c_port_t port)
+{
+    if (port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+
+    SEMAPHORE_TAKE(port);
+
+    esp_err_t res = ESP_OK;
+    if (states[port].installed)
+    {
+        ESP_LOGW(TAG, "Reinstalling driver on port %d", port);
+        res = reinstall_port(port);
+    }
+
+    SEMAPHORE_GIVE(port);
+    return res;
+}
+
+static bool clock_out_bus(gpio_num_t scl, gpio_num_t sda)
+{
+    gpio_config_t io_conf;
+    int i;
+
+    memset(&io_conf, 0, sizeof(io_conf));
+    io_conf.mode = GPIO_MODE_OUTPUT_OD;
+    io_conf.pin_bit_mask = (1 << scl) | (1 << sda);
+    io_conf.pull_up_en = 1;
+    gpio_config(&io_conf);
+
+    gpio_set_level(sda, 1);
+    gpio_set_level(scl, 1);
+    ets_delay_us(RECOVERY_HALF_CLK_US);
+
+    // The slave shifts out the rest of its byte, then sees a NACK
+    for (i = 0; i < RECOVERY_SCL_PULSES && !gpio_get_level(sda); i++)
+    {
+        gpio_set_level(scl, 0);
+        ets_delay_us(RECOVERY_HALF_CLK_US);
+        gpio_set_level(scl, 1);
+        ets_delay_us(RECOVERY_HALF_CLK_US);
+    }
+
+    // STOP: SDA rising while SCL is high
+    gpio_set_level(scl, 0);
+    ets_delay_us(RECOVERY_HALF_CLK_US);
+    gpio_set_level(sda, 0);
+    ets_delay_us(RECOVERY_HALF_CLK_US);
+    gpio_set_level(scl, 1);
+    ets_delay_us(RECOVERY_HALF_CLK_US);
+    gpio_set_level(sda, 1);
+    ets_delay_us(RECOVERY_HALF_CLK_US);
+
+    return gpio_get_level(sda) && gpio_get_level(scl);
+}
+
+// Port mutex must be taken. Bounded by the clock out, at most
+// RECOVERY_SCL_PULSES + 2 clocks, and a driver reinstall.
+static esp_err_t recover_locked(i2c_port_t port)
+{
+    i2c_port_state_t *st = &states[port];
+    gpio_num_t scl = st->config.scl_io_num;
+    gpio_num_t sda = st->config.sda_io_num;
+
+    // Pins are only known once a device used the port, the next device
+    // transaction does a full setup
+    if (scl == sda)
+    {
+        st->stuck = false;
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGW(TAG, "Recovering bus on port %d", port);
+
+    int64_t start = esp_timer_get_time();
+
+    if (st->installed)
+        i2c_driver_delete(port);
+    st->installed = false;
+
+    bool released = clock_out_bus(scl, sda);
+    if (!released)
+        ESP_LOGE(TAG, "SDA still held low on port %d", port);
+
+    esp_err_t res = reinstall_port(port);
+    if (res == ESP_OK && !released)
+        res = ESP_FAIL;
+
+    int64_t end = esp_timer_get_time();
+    uint32_t t = end - start;
+
+    st->bus_stats.recoveries++;
+    st->bus_stats.recovery_last_us = t;
+    if (t > st->bus_stats.recovery_max_us)
+        st->bus_stats.recovery_max_us = t;
+
+    st->stuck = res != ESP_OK;
+    if (st->stuck)
+    {
+        st->bus_stats.recovery_failures++;
+        st->stuck_retry = end + CONFIG_I2CDEV_STUCK_HOLDOFF * 1000LL;
+    }
+
+    return res;
+}
+
+esp_err_t i2cdev_recover_bus(i2c_port_t port)
+{
+    if (port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+
+    SEMAPHORE_TAKE(port);
+
+    esp_err_t res = ESP_ERR_INVALID_STATE;
+    if (states[port].installed || states[port].stuck)
+        res = recover_locked(port);
+
+    SEMAPHORE_GIVE(port);
+    return res;
+}
+
+esp_err_t i2cdev_get_bus_stats(i2c_port_t port, i2cdev_bus_stats_t *stats)
+{
+    if (port >= I2C_NUM_MAX || !stats) return ESP_ERR_INVALID_ARG;
+
+    SEMAPHORE_TAKE(port);
+    *stats = states[port].bus_stats;
+    stats->stuck = states[port].stuck;
+    SEMAPHORE_GIVE(port);
+
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_bench(i2c_port_t port, uint8_t addr, uint32_t stretch_tick,
+        const void *out_data, size_t out_size, void *in_data, size_t in_size,
+        uint32_t count, i2cdev_bench_t *res)
+{
+    if (port >= I2C_NUM_MAX || !res || !count) return ESP_ERR_INVALID_ARG;
+    if ((!out_data || !out_size) && (!in_data || !in_size)) return ESP_ERR_INVALID_ARG;
+
+    memset(res, 0, sizeof(i2cdev_bench_t));
+
+    SEMAPHORE_TAKE(port);
+    bool installed = states[port].installed;
+    i2c_config_t saved = states[port].config;
+    SEMAPHORE_GIVE(port);
+
+    if (!installed)
+        return ESP_ERR_INVALID_STATE;
+
+    // A device with the settings of the port. With another stretch timeout
+    // the arbiter reinstalls the driver whenever it switches between it and
+    // the other devices, callers keep the bus to themselves in that case
+    i2c_dev_t dev = {
+        .port = port,
+        .cfg = saved,
+        .addr = addr,
+        .prio = I2CDEV_PRIO_LOW,
+    };
+#if HELPER_TARGET_IS_ESP8266 && HELPER_TARGET_VERSION > HELPER_TARGET_VERSION_ESP8266_V3_2
+    dev.timeout_ticks = stretch_tick ? stretch_tick : saved.clk_stretch_tick;
+#endif
+
+    int64_t total = 0, t;
+    esp_err_t ret = ESP_OK;
+
+    res->lat_min_us = UINT32_MAX;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        i2cdev_req_t req = {
+            .dev = &dev,
+            .out = out_data,
+            .out_size = out_data ? out_size : 0,
+            .in = in_data,
+            .in_size = in_data ? in_size : 0,
+            .bench = true,
+        };
+
+        esp_err_t err = submit_wait(&req);
+        if (err != ESP_OK)
+        {
+            res->errors++;
+            continue;
+        }
+
+        res->transactions++;
+        res->bytes += req.out_size + req.in_size;
+        // Bus time only, the wait in the queue says nothing about the timing
+        t = req.bus_us;
+        total += t;
+        if (t < res->lat_min_us) res->lat_min_us = t;
+        if (t > res->lat_max_us) res->lat_max_us = t;
+    }
+    res->elapsed_us = total;
+
+    if (res->transactions)
+        res->lat_avg_us = total / res->transactions;
+    else
+        res->lat_min_us = 0;
+
+#if HELPER_TARGET_IS_ESP8266 && HELPER_TARGET_VERSION > HELPER_TARGET_VERSION_ESP8266_V3_2
+    // Back to the settings of the devices, unless one of them already did it
+    SEMAPHORE_TAKE(port);
+    if (states[port].installed && states[port].config.clk_stretch_tick != saved.clk_stretch_tick)
+    {
+        states[port].config = saved;
+        ret = reinstall_port(port);
+    }
+    SEMAPHORE_GIVE(port);
+#endif
+
+    return ret;
+}
@@ -15,6 +15,7 @@
 #include <driver/i2c.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
+#include <freertos/task.h>
 #include <esp_err.h>
 
 #ifdef __cplusplus
@@ -24,6 +25,11 @@ extern "C" {
     
 #define HELPER_TARGET_IS_ESP8266  1
 
+// ESP8266_RTOS_SDK v3.3, i2c_config_t has clk_stretch_tick since v3.3
+#define HELPER_TARGET_VERSION_ESP8266_V3_2  1
+#define HELPER_TARGET_VERSION_ESP8266_V3_3  2
+#define HELPER_TARGET_VERSION               HELPER_TARGET_VERSION_ESP8266_V3_3
+
 #if HELPER_TARGET_IS_ESP8266
 #define I2CDEV_MAX_STRETCH_TIME 0xffffffff
 #else
@@ -35,6 +41,94 @@ extern "C" {
 #endif
 #endif
 
+/**
+ * Transaction priority, used by the bus arbiter task
+ */
+typedef enum
+{
+    I2CDEV_PRIO_HIGH = 0,    //!< Ahead of every queued low priority transaction, the default
+    I2CDEV_PRIO_LOW,         //!< Bulk transfers like display pages, sent in small chunks
+} i2cdev_prio_t;
+
+/**
+ * Max segments of a batched transaction
+ */
+#define I2CDEV_SEGS_MAX 4
+
+/**
+ * Segment of a batched transaction, see ::i2c_dev_batch()
+ *
+ * A START and the address, then \p out_size bytes written, then a repeated
+ * START and \p in_size bytes read. Either part may be empty.
+ */
+typedef struct
+{
+    const void *out;         //!< Data to send if non-null
+    size_t out_size;
+    void *in;                //!< Input buffer if non-null
+    size_t in_size;
+} i2cdev_seg_t;
+
+/**
+ * Command link pool counters, see ::i2cdev_get_cmd_stats()
+ */
+typedef struct
+{
+    uint32_t allocs;         //!< Command links built, each one allocates from the heap
+    uint32_t reuses;         //!< Transactions replaying a pooled command link
+    uint32_t unpooled;       //!< Transactions too large for the pool buffers
+} i2cdev_cmd_stats_t;
+
+/**
+ * Latency histogram buckets, bucket n counts transactions of 2^n to
+ * 2^(n+1) - 1 us, the last one everything above
+ */
+#define I2CDEV_LAT_BUCKETS 16
+
+/**
+ * Per device counters, see ::i2cdev_get_dev_stats()
+ */
+typedef struct
+{
+    uint8_t addr;            //!< Unshifted address
+    uint32_t transactions;   //!< All transactions, failed ones included
+    uint32_t bytes;          //!< Bytes of the successful transactions, address excluded
+    uint32_t err_nack;       //!< ESP_FAIL, no acknowledge
+    uint32_t err_timeout;    //!< ESP_ERR_TIMEOUT
+    uint32_t err_other;      //!< Any other error code
+    uint64_t busy_us;        //!< Time spent on the bus, port setup included
+    uint64_t wait_us;        //!< Time waiting for the bus, arbiter queue and port mutex
+    uint32_t wait_max_us;
+    uint32_t lat_hist[I2CDEV_LAT_BUCKETS]; //!< log2 histogram of the time on the bus
+} i2cdev_dev_stats_t;
+
+/**
+ * Bus recovery counters, see ::i2cdev_get_bus_stats()
+ */
+typedef struct
+{
+    uint32_t recoveries;        //!< Clock outs, automatic and requested
+    uint32_t recovery_failures; //!< SDA still low or driver not reinstalled
+    uint32_t recovery_last_us;  //!< Duration of the last recovery
+    uint32_t recovery_max_us;
+    uint32_t fast_fails;        //!< Transactions refused while the bus is stuck
+    bool stuck;                 //!< Last recovery failed
+} i2cdev_bus_stats_t;
+
+/**
+ * Benchmark result, see ::i2cdev_bench()
+ */
+typedef struct
+{
+    uint32_t transactions;   //!< Successful transactions
+    uint32_t errors;         //!< Failed transactions
+    uint32_t bytes;          //!< Data bytes of the successful transactions, address excluded
+    uint32_t elapsed_us;     //!< Bus time of the successful transactions
+    uint32_t lat_min_us;     //!< Transaction bus time, queue wait excluded
+    uint32_t lat_avg_us;
+    uint32_t lat_max_us;
+} i2cdev_bench_t;
+
 /**
  * I2C device descriptor
  */
@@ -44,16 +138,59 @@ typedef struct
     i2c_config_t cfg;        //!< I2C driver configuration
     uint8_t addr;            //!< Unshifted address
     SemaphoreHandle_t mutex; //!< Device mutex
+    i2cdev_prio_t prio;      //!< Transaction priority
     uint32_t timeout_ticks;  /*!< HW I2C bus timeout (stretch time), in ticks. 80MHz APB clock
                                   ticks for ESP-IDF, CPU ticks for ESP8266.
-                                  When this value is 0, I2CDEV_MAX_STRETCH_TIME will be used */
+                                  When this value is 0, CONFIG_I2CDEV_CLK_STRETCH_TICK will be
+                                  used, or I2CDEV_MAX_STRETCH_TIME if that is 0 as well */
 } i2c_dev_t;
 
+typedef struct i2cdev_req i2cdev_req_t;
+
+/**
+ * Completion callback of an asynchronous transaction, called from the bus
+ * arbiter task. It must not block, transactions it submits run right away.
+ */
+typedef void (*i2cdev_cb_t)(i2cdev_req_t *req);
+
+/**
+ * Asynchronous transaction, see ::i2cdev_submit()
+ *
+ * The register address and data are written, then \p in_size bytes are read
+ * after a repeated start. With \p segs set it is a batch instead, see
+ * ::i2c_dev_batch(). The request and its buffers belong to the bus until it
+ * is done.
+ */
+struct i2cdev_req
+{
+    const i2c_dev_t *dev;    //!< Device descriptor, NULL for a port already set up by a device
+    i2c_port_t port;         //!< I2C port number, taken from dev when set
+    uint8_t addr;            //!< Unshifted address, taken from dev when set
+    i2cdev_prio_t prio;      //!< Transaction priority, taken from dev when set
+    const void *reg;         //!< Register address to send if non-null
+    size_t reg_size;
+    const void *out;         //!< Data to send if non-null
+    size_t out_size;
+    void *in;                //!< Input buffer if non-null
+    size_t in_size;
+    const i2cdev_seg_t *segs; //!< Batch segments if non-null, reg, out and in are not used
+    size_t seg_count;
+    i2cdev_cb_t cb;          //!< Completion callback, NULL to notify the submitting task
+    void *arg;               //!< Callback argument
+    volatile bool done;      //!< Set once the request is released, after the callback
+    esp_err_t res;           //!< Result, valid once done
+    TaskHandle_t task;       //!< Set by ::i2cdev_submit()
+    int64_t submitted;       //!< Set by ::i2cdev_submit()
+    uint32_t bus_us;         //!< Set by the arbiter, duration of the transfer
+    bool bench;              //!< Benchmark transaction, left out of the device counters
+};
+
 /**
  * @brief Init library
  *
  * The function must be called before any other
- * functions of this library.
+ * functions of this library. With CONFIG_I2CDEV_ARBITER it starts the task
+ * owning the buses, every transaction is queued to it by priority.
  *
  * @return ESP_OK on success
  */
@@ -100,6 +237,14 @@ esp_err_t i2c_dev_take_mutex(i2c_dev_t *dev);
  */
 esp_err_t i2c_dev_give_mutex(i2c_dev_t *dev);
 
+/**
+ * @brief Clock stretch timeout the port is set up with for a device
+ *
+ * @param dev Device descriptor
+ * @return Device timeout_ticks, or the Kconfig default when 0
+ */
+uint32_t i2c_dev_get_stretch_tick(const i2c_dev_t *dev);
+
 /**
  * @brief Read from slave device
  *
@@ -161,6 +306,178 @@ esp_err_t i2c_dev_read_reg(const i2c_dev_t *dev, uint8_t reg,
 esp_err_t i2c_dev_write_reg(const i2c_dev_t *dev, uint8_t reg,
         const void *out_data, size_t out_size);
 
+/**
+ * @brief Write to slave device on an already configured port
+ *
+ * Same as ::i2c_dev_write() for code without a device descriptor, the port
+ * must have been set up by a device before.
+ * Function is thread-safe.
+ *
+ * @param port I2C port number
+ * @param addr Unshifted address
+ * @param prio Transaction priority
+ * @param out_reg Pointer to register address to send if non-null
+ * @param out_reg_size Size of register address
+ * @param out_data Pointer to data to send
+ * @param out_size Size of data to send
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the port is not set up
+ */
+esp_err_t i2cdev_port_write(i2c_port_t port, uint8_t addr, i2cdev_prio_t prio,
+        const void *out_reg, size_t out_reg_size, const void *out_data, size_t out_size);
+
+/**
+ * @brief Run a batch of transfers as a single transaction
+ *
+ * Up to I2CDEV_SEGS_MAX segments are chained with repeated STARTs and only
+ * the last one ends with a STOP, like a register write followed by the read
+ * of another register. The port is taken and the driver entered once for the
+ * whole batch, which stops at the first segment not acknowledged.
+ * Function is thread-safe.
+ *
+ * @param dev Device descriptor
+ * @param segs Segments
+ * @param count Number of segments
+ * @return ESP_OK on success
+ */
+esp_err_t i2c_dev_batch(const i2c_dev_t *dev, const i2cdev_seg_t *segs, size_t count);
+
+/**
+ * @brief Run a batch of transfers on an already configured port
+ *
+ * Same as ::i2c_dev_batch() for code without a device descriptor, see
+ * ::i2cdev_port_write().
+ *
+ * @param port I2C port number
+ * @param addr Unshifted address
+ * @param prio Transaction priority
+ * @param segs Segments
+ * @param count Number of segments
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the port is not set up
+ */
+esp_err_t i2cdev_port_batch(i2c_port_t port, uint8_t addr, i2cdev_prio_t prio,
+        const i2cdev_seg_t *segs, size_t count);
+
+/**
+ * @brief Queue a transaction without waiting for it
+ *
+ * The request goes to the bus arbiter task by priority and the call returns
+ * right away, ESP_ERR_TIMEOUT if the queue stayed full for
+ * CONFIG_I2CDEV_TIMEOUT. On completion \p req->res is set and \p req->cb is
+ * called, or the submitting task notified when there is no callback. Without
+ * CONFIG_I2CDEV_ARBITER the transaction runs before the call returns.
+ * Requests of one task may share its notification, ::i2cdev_wait() checks
+ * \p req->done. The request must not be submitted again before it is done.
+ *
+ * @param req Transaction, dev or port and addr must be set
+ * @return ESP_OK if the request was queued
+ */
+esp_err_t i2cdev_submit(i2cdev_req_t *req);
+
+/**
+ * @brief Wait for a transaction queued without a callback
+ *
+ * Must be called from the task which submitted it.
+ *
+ * @param req Transaction
+ * @param wait Max wait, in ticks
+ * @return Transaction result, ESP_ERR_TIMEOUT if it is not done yet
+ */
+esp_err_t i2cdev_wait(i2cdev_req_t *req, TickType_t wait);
+
+/**
+ * @brief Get the command link pool counters of a port
+ *
+ * Transactions reuse a command link built for the same address and sizes,
+ * from a pool of CONFIG_I2CDEV_CMD_POOL_SIZE links per port. Once every
+ * transaction shape has been seen, allocs stops growing.
+ *
+ * @param port I2C port number
+ * @param[out] stats Counters
+ * @param clear Reset the counters after reading them
+ * @return ESP_OK on success
+ */
+esp_err_t i2cdev_get_cmd_stats(i2c_port_t port, i2cdev_cmd_stats_t *stats, bool clear);
+
+/**
+ * @brief Get the per device counters of a port
+ *
+ * Devices are counted by address in the order of their first transaction,
+ * up to CONFIG_I2CDEV_STATS_DEVS. Benchmark transactions are not counted.
+ *
+ * @param port I2C port number
+ * @param[out] stats Counters, one per device
+ * @param[inout] count Size of \p stats, then number of devices returned
+ * @param clear Reset the counters of every device after reading them
+ * @return ESP_OK on success
+ */
+esp_err_t i2cdev_get_dev_stats(i2c_port_t port, i2cdev_dev_stats_t *stats, int *count, bool clear);
+
+/**
+ * @brief Measure the throughput and latency of a transaction
+ *
+ * Run the same transaction \p count times, one after the other, on an
+ * already set up port. Every one is queued like any other low priority
+ * transaction, so high priority ones still go first. Only the transfer
+ * itself is timed, not the wait in the queue. A \p stretch_tick other than
+ * the one of the devices reinstalls the driver every time the arbiter
+ * switches between them and the benchmark, so only pass one while the other
+ * devices are idle. The timing of the devices is restored at the end of the
+ * run. There is no SCL frequency setting, the ESP8266 driver clocks the bus
+ * in software at a fixed rate.
+ *
+ * @param port I2C port number
+ * @param addr Unshifted address
+ * @param stretch_tick Clock stretch timeout in ticks, 0 to keep the current one
+ * @param out_data Pointer to data to send if non-null
+ * @param out_size Size of data to send
+ * @param[out] in_data Pointer to input data buffer if non-null, read after the data sent
+ * @param in_size Number of byte to read
+ * @param count Number of transactions
+ * @param[out] res Result
+ * @return ESP_OK on success, even if some transactions failed
+ */
+esp_err_t i2cdev_bench(i2c_port_t port, uint8_t addr, uint32_t stretch_tick,
+        const void *out_data, size_t out_size, void *in_data, size_t in_size,
+        uint32_t count, i2cdev_bench_t *res);
+
+/**
+ * @brief Reinstall the I2C driver of a port
+ *
+ * Delete the driver and install it again with the same configuration, to
+ * get the controller out of an error state.
+ * Function is thread-safe.
+ *
+ * @param port I2C port number
+ * @return ESP_OK on success
+ */
+esp_err_t i2cdev_reset_port(i2c_port_t port);
+
+/**
+ * @brief Recover a stuck I2C bus
+ *
+ * A slave interrupted in the middle of a read, by a brown-out for instance,
+ * can hold SDA low forever. Release the driver, clock SCL up to nine times
+ * until SDA is released, send a STOP and install the driver again.
+ * Also done automatically after CONFIG_I2CDEV_STUCK_TIMEOUTS consecutive
+ * transaction timeouts on the port. While it fails, transactions are
+ * refused with ESP_ERR_INVALID_STATE and the recovery is retried every
+ * CONFIG_I2CDEV_STUCK_HOLDOFF ms.
+ * Function is thread-safe.
+ *
+ * @param port I2C port number
+ * @return ESP_OK if SDA was released
+ */
+esp_err_t i2cdev_recover_bus(i2c_port_t port);
+
+/**
+ * @brief Get the bus recovery counters of a port
+ *
+ * @param port I2C port number
+ * @param[out] stats Counters
+ * @return ESP_OK on success
+ */
+esp_err_t i2cdev_get_bus_stats(i2c_port_t port, i2cdev_bus_stats_t *stats);
+
 #define I2C_DEV_TAKE_MUTEX(dev) do { \
         esp_err_t __ = i2c_dev_take_mutex(dev); \
         if (__ != ESP_OK) return __;\
@@ -39,6 +39,9 @@ extern "C" {
 #define NVS_POWER_OFF            "PowerOff"
 #define NVS_BATTERY_DISCHARGED   "BatDischarged"
 
+/* ADC calibration blob, one key per channel: AdcCal0, AdcCal1... */
+#define NVS_ADC_CAL              "AdcCal"
+
 #define NVS_WIFI_AP_MODE         "WiFiApMode"
 #define NVS_WIFI_SSID            "WiFiSSID"
 #define NVS_WIFI_PASS            "WiFiPass"
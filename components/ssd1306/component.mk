@@ -2,3 +2,10 @@
 # Component makefile.
 #
 COMPONENT_ADD_INCLUDEDIRS := .
+
+# Page packed fonts for ssd1306_WriteChar(), regenerated when the row-major
+# tables or the converter change. The committed file is only replaced once
+# the conversion succeeded.
+$(COMPONENT_PATH)/ssd1306_fonts_paged.c: $(COMPONENT_PATH)/ssd1306_fonts.c $(COMPONENT_PATH)/ssd1306_fontconv.py
+	$(PYTHON) $(COMPONENT_PATH)/ssd1306_fontconv.py $< > $@.tmp
+	mv $@.tmp $@
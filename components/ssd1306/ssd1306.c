@@ -14,6 +14,11 @@ void ssd1306_WriteCommand(uint8_t byte) {
     HAL_I2C_Mem_Write(SSD1306_I2C_PORT, SSD1306_I2C_ADDR, 0x00, 1, &byte, 1, HAL_MAX_DELAY);
 }
 
+// Send a command stream after one control byte, in one I2C transaction
+void ssd1306_WriteCommands(const uint8_t* cmds, size_t count) {
+    HAL_I2C_Mem_Write_Burst(SSD1306_I2C_PORT, SSD1306_I2C_ADDR, 0x00, cmds, count);
+}
+
 // Send data
 void ssd1306_WriteData(uint8_t* buffer, size_t buff_size) {
     HAL_I2C_Mem_Write(SSD1306_I2C_PORT, SSD1306_I2C_ADDR, 0x40, 1, buffer, buff_size, HAL_MAX_DELAY);
@@ -40,6 +45,13 @@ void ssd1306_WriteCommand(uint8_t byte) {
     HAL_GPIO_WritePin(SSD1306_CS_Port, SSD1306_CS_Pin, GPIO_PIN_SET); // un-select OLED
 }
 
+// Send several commands
+void ssd1306_WriteCommands(const uint8_t* cmds, size_t count) {
+    while(count--) {
+        ssd1306_WriteCommand(*cmds++);
+    }
+}
+
 // Send data
 void ssd1306_WriteData(uint8_t* buffer, size_t buff_size) {
     HAL_GPIO_WritePin(SSD1306_CS_Port, SSD1306_CS_Pin, GPIO_PIN_RESET); // select OLED
@@ -53,113 +65,153 @@ void ssd1306_WriteData(uint8_t* buffer, size_t buff_size) {
 #endif
 
 
-// Screenbuffer
-static uint8_t SSD1306_Buffer[SSD1306_BUFFER_SIZE];
+// Screenbuffer, all the drawing goes here
+static SSD1306_Frame_t SSD1306_Screen;
 
 // Screen object
 static SSD1306_t SSD1306;
 
+// Add a column of a page to the dirty span of the page
+static inline void ssd1306_MarkDirty(uint8_t x, uint8_t page) {
+    if(x < SSD1306_Screen.DirtyLo[page]) {
+        SSD1306_Screen.DirtyLo[page] = x;
+    }
+    if(x > SSD1306_Screen.DirtyHi[page]) {
+        SSD1306_Screen.DirtyHi[page] = x;
+    }
+}
+
+// Store a screenbuffer byte, tracking it only when it really changes
+static inline void ssd1306_SetByte(uint32_t i, uint8_t value) {
+    if(SSD1306_Screen.Buffer[i] != value) {
+        SSD1306_Screen.Buffer[i] = value;
+        ssd1306_MarkDirty(i % SSD1306_WIDTH, i / SSD1306_WIDTH);
+    }
+}
+
+// Mark the whole screen as changed, the next update resends everything
+void ssd1306_Invalidate(void) {
+    memset(SSD1306_Screen.DirtyLo, 0, sizeof(SSD1306_Screen.DirtyLo));
+    memset(SSD1306_Screen.DirtyHi, SSD1306_WIDTH - 1, sizeof(SSD1306_Screen.DirtyHi));
+}
+
 /* Fills the Screenbuffer with values from a given buffer of a fixed length */
 SSD1306_Error_t ssd1306_FillBuffer(uint8_t* buf, uint32_t len) {
     SSD1306_Error_t ret = SSD1306_ERR;
+    uint32_t i;
+
     if (len <= SSD1306_BUFFER_SIZE) {
-        memcpy(SSD1306_Buffer,buf,len);
+        for(i = 0; i < len; i++) {
+            ssd1306_SetByte(i, buf[i]);
+        }
         ret = SSD1306_OK;
     }
     return ret;
 }
 
-// Initialize the oled screen
-void ssd1306_Init(void) {
-    // Reset OLED
-    ssd1306_Reset();
+// Init sequence, sent as one command stream
+static const uint8_t ssd1306_InitCmds[] = {
+    0xAE, //display off
 
-    // Wait for the screen to boot
-    HAL_Delay(100);
-
-    // Init OLED
-    ssd1306_SetDisplayOn(0); //display off
+    0x20, //Set Memory Addressing Mode
+    0x00, // 00b,Horizontal Addressing Mode; 01b,Vertical Addressing Mode;
+          // 10b,Page Addressing Mode (RESET); 11b,Invalid
 
-    ssd1306_WriteCommand(0x20); //Set Memory Addressing Mode
-    ssd1306_WriteCommand(0x00); // 00b,Horizontal Addressing Mode; 01b,Vertical Addressing Mode;
-                                // 10b,Page Addressing Mode (RESET); 11b,Invalid
-
-    ssd1306_WriteCommand(0xB0); //Set Page Start Address for Page Addressing Mode,0-7
+    0xB0, //Set Page Start Address for Page Addressing Mode,0-7
 
 #ifdef SSD1306_MIRROR_VERT
-    ssd1306_WriteCommand(0xC0); // Mirror vertically
+    0xC0, // Mirror vertically
 #else
-    ssd1306_WriteCommand(0xC8); //Set COM Output Scan Direction
+    0xC8, //Set COM Output Scan Direction
 #endif
 
-    ssd1306_WriteCommand(0x00); //---set low column address
-    ssd1306_WriteCommand(0x10); //---set high column address
+    0x00, //---set low column address
+    0x10, //---set high column address
 
-    ssd1306_WriteCommand(0x40); //--set start line address - CHECK
+    0x40, //--set start line address - CHECK
 
-    ssd1306_SetContrast(0xFF);
+    0x81, //--set contrast control register
+    0xFF,
 
 #ifdef SSD1306_MIRROR_HORIZ
-    ssd1306_WriteCommand(0xA0); // Mirror horizontally
+    0xA0, // Mirror horizontally
 #else
-    ssd1306_WriteCommand(0xA1); //--set segment re-map 0 to 127 - CHECK
+    0xA1, //--set segment re-map 0 to 127 - CHECK
 #endif
 
 #ifdef SSD1306_INVERSE_COLOR
-    ssd1306_WriteCommand(0xA7); //--set inverse color
+    0xA7, //--set inverse color
 #else
-    ssd1306_WriteCommand(0xA6); //--set normal color
+    0xA6, //--set normal color
 #endif
 
 // Set multiplex ratio.
 #if (SSD1306_HEIGHT == 128)
     // Found in the Luma Python lib for SH1106.
-    ssd1306_WriteCommand(0xFF);
+    0xFF,
 #else
-    ssd1306_WriteCommand(0xA8); //--set multiplex ratio(1 to 64) - CHECK
+    0xA8, //--set multiplex ratio(1 to 64) - CHECK
 #endif
 
 #if (SSD1306_HEIGHT == 32)
-    ssd1306_WriteCommand(0x1F); //
+    0x1F, //
 #elif (SSD1306_HEIGHT == 64)
-    ssd1306_WriteCommand(0x3F); //
+    0x3F, //
 #elif (SSD1306_HEIGHT == 128)
-    ssd1306_WriteCommand(0x3F); // Seems to work for 128px high displays too.
+    0x3F, // Seems to work for 128px high displays too.
 #else
 #error "Only 32, 64, or 128 lines of height are supported!"
 #endif
 
-    ssd1306_WriteCommand(0xA4); //0xa4,Output follows RAM content;0xa5,Output ignores RAM content
+    0xA4, //0xa4,Output follows RAM content;0xa5,Output ignores RAM content
 
-    ssd1306_WriteCommand(0xD3); //-set display offset - CHECK
-    ssd1306_WriteCommand(0x00); //-not offset
+    0xD3, //-set display offset - CHECK
+    0x00, //-not offset
 
-    ssd1306_WriteCommand(0xD5); //--set display clock divide ratio/oscillator frequency
-    ssd1306_WriteCommand(0xF0); //--set divide ratio
+    0xD5, //--set display clock divide ratio/oscillator frequency
+    0xF0, //--set divide ratio
 
-    ssd1306_WriteCommand(0xD9); //--set pre-charge period
-    ssd1306_WriteCommand(0x22); //
+    0xD9, //--set pre-charge period
+    0x22, //
 
-    ssd1306_WriteCommand(0xDA); //--set com pins hardware configuration - CHECK
+    0xDA, //--set com pins hardware configuration - CHECK
 #if (SSD1306_HEIGHT == 32)
-    ssd1306_WriteCommand(0x02);
+    0x02,
 #elif (SSD1306_HEIGHT == 64)
-    ssd1306_WriteCommand(0x12);
+    0x12,
 #elif (SSD1306_HEIGHT == 128)
-    ssd1306_WriteCommand(0x12);
+    0x12,
 #else
 #error "Only 32, 64, or 128 lines of height are supported!"
 #endif
 
-    ssd1306_WriteCommand(0xDB); //--set vcomh
-    ssd1306_WriteCommand(0x20); //0x20,0.77xVcc
+    0xDB, //--set vcomh
+    0x20, //0x20,0.77xVcc
+
+    0x8D, //--set DC-DC enable
+    0x14, //
+    0xAF, //--turn on SSD1306 panel
+};
 
-    ssd1306_WriteCommand(0x8D); //--set DC-DC enable
-    ssd1306_WriteCommand(0x14); //
-    ssd1306_SetDisplayOn(1); //--turn on SSD1306 panel
+// Power sequences, the charge pump is stopped while the panel is off
+static const uint8_t ssd1306_DisplayOffCmds[] = { 0xAE, 0x8D, 0x10 };
+static const uint8_t ssd1306_DisplayOnCmds[] = { 0x8D, 0x14, 0xAF };
 
-    // Clear screen
+// Initialize the oled screen
+void ssd1306_Init(void) {
+    // Reset OLED
+    ssd1306_Reset();
+
+    // Wait for the screen to boot
+    HAL_Delay(100);
+
+    // Init OLED
+    ssd1306_WriteCommands(ssd1306_InitCmds, sizeof(ssd1306_InitCmds));
+    SSD1306.DisplayOn = 1;
+
+    // Clear screen, the panel RAM content is unknown after reset
     ssd1306_Fill(Black);
+    ssd1306_Invalidate();
     
     // Flush buffer to screen
     ssd1306_UpdateScreen();
@@ -176,25 +228,120 @@ void ssd1306_Fill(SSD1306_COLOR color) {
     /* Set memory */
     uint32_t i;
 
-    for(i = 0; i < sizeof(SSD1306_Buffer); i++) {
-        SSD1306_Buffer[i] = (color == Black) ? 0x00 : 0xFF;
+    for(i = 0; i < sizeof(SSD1306_Screen.Buffer); i++) {
+        ssd1306_SetByte(i, (color == Black) ? 0x00 : 0xFF);
     }
 }
 
-// Write the screenbuffer with changed to the screen
-void ssd1306_UpdateScreen(void) {
-    // Write data to each page of RAM. Number of pages
-    // depends on the screen height:
+// Write the dirty columns of each page of RAM, returns 0 if nothing changed
+static uint8_t ssd1306_FlushDirty(SSD1306_Frame_t* frame) {
+    uint8_t sent = 0;
+
+    // Number of pages depends on the screen height:
     //
     //  * 32px   ==  4 pages
     //  * 64px   ==  8 pages
     //  * 128px  ==  16 pages
     for(uint8_t i = 0; i < SSD1306_HEIGHT/8; i++) {
-        ssd1306_WriteCommand(0xB0 + i); // Set the current RAM page address.
-        ssd1306_WriteCommand(0x00);
-        ssd1306_WriteCommand(0x10);
-        ssd1306_WriteData(&SSD1306_Buffer[SSD1306_WIDTH*i],SSD1306_WIDTH);
+        uint8_t lo = frame->DirtyLo[i];
+        uint8_t hi = frame->DirtyHi[i];
+
+        if(lo > hi) {
+            continue;
+        }
+
+        // Horizontal addressing mode: limit the column and page window to
+        // the dirty span, the data then lands in it without any wrapping
+        const uint8_t cmds[] = { 0x21, lo, hi, 0x22, i, i };
+        ssd1306_WriteCommands(cmds, sizeof(cmds));
+        ssd1306_WriteData(&frame->Buffer[SSD1306_WIDTH*i + lo], hi - lo + 1);
+
+        frame->DirtyLo[i] = 0xFF;
+        frame->DirtyHi[i] = 0;
+        sent = 1;
     }
+
+    return sent;
+}
+
+// Write the whole frame if anything changed, returns 0 if not
+static uint8_t ssd1306_FlushBurst(SSD1306_Frame_t* frame) {
+    uint8_t i;
+
+    for(i = 0; i < SSD1306_HEIGHT/8; i++) {
+        if(frame->DirtyLo[i] <= frame->DirtyHi[i]) {
+            break;
+        }
+    }
+    if(i == SSD1306_HEIGHT/8) {
+        return 0;
+    }
+
+    // The window is the whole RAM, one stream of data fills it page by page.
+    // The stream still goes in short chunks so the ADC gets the bus between
+    // them, the address pointer moves on in the window from chunk to chunk.
+    const uint8_t cmds[] = { 0x21, 0, SSD1306_WIDTH - 1, 0x22, 0, SSD1306_HEIGHT/8 - 1 };
+    ssd1306_WriteCommands(cmds, sizeof(cmds));
+    ssd1306_WriteData(frame->Buffer, sizeof(frame->Buffer));
+
+    memset(frame->DirtyLo, 0xFF, sizeof(frame->DirtyLo));
+    memset(frame->DirtyHi, 0, sizeof(frame->DirtyHi));
+
+    return 1;
+}
+
+// Write a frame with changes to the screen
+void ssd1306_UpdateFrame(SSD1306_Frame_t* frame) {
+    uint32_t start = HAL_GetMicros();
+    uint8_t sent;
+
+    if(SSD1306.FlushMode == SSD1306_FLUSH_BURST) {
+        sent = ssd1306_FlushBurst(frame);
+    } else {
+        sent = ssd1306_FlushDirty(frame);
+    }
+
+    if(sent) {
+        SSD1306.FrameTime = HAL_GetMicros() - start;
+    }
+}
+
+// Write the screenbuffer with changes to the screen
+void ssd1306_UpdateScreen(void) {
+    ssd1306_UpdateFrame(&SSD1306_Screen);
+}
+
+// Copy the changes of the screenbuffer to a frame, adding them to the ones
+// the frame has not sent yet. The screenbuffer is clean afterwards.
+void ssd1306_CopyFrame(SSD1306_Frame_t* frame) {
+    for(uint8_t i = 0; i < SSD1306_HEIGHT/8; i++) {
+        uint8_t lo = SSD1306_Screen.DirtyLo[i];
+        uint8_t hi = SSD1306_Screen.DirtyHi[i];
+
+        if(lo > hi) {
+            continue;
+        }
+
+        memcpy(&frame->Buffer[SSD1306_WIDTH*i + lo], &SSD1306_Screen.Buffer[SSD1306_WIDTH*i + lo],
+               hi - lo + 1);
+        if(lo < frame->DirtyLo[i]) {
+            frame->DirtyLo[i] = lo;
+        }
+        if(hi > frame->DirtyHi[i]) {
+            frame->DirtyHi[i] = hi;
+        }
+
+        SSD1306_Screen.DirtyLo[i] = 0xFF;
+        SSD1306_Screen.DirtyHi[i] = 0;
+    }
+}
+
+void ssd1306_SetFlushMode(SSD1306_FLUSH_MODE mode) {
+    SSD1306.FlushMode = mode;
+}
+
+uint32_t ssd1306_GetFrameTime(void) {
+    return SSD1306.FrameTime;
 }
 
 //    Draw one pixel in the screenbuffer
@@ -213,76 +360,276 @@ void ssd1306_DrawPixel(uint8_t x, uint8_t y, SSD1306_COLOR color) {
     }
     
     // Draw in the right color
+    uint32_t i = x + (y / 8) * SSD1306_WIDTH;
     if(color == White) {
-        SSD1306_Buffer[x + (y / 8) * SSD1306_WIDTH] |= 1 << (y % 8);
-    } else { 
-        SSD1306_Buffer[x + (y / 8) * SSD1306_WIDTH] &= ~(1 << (y % 8));
+        ssd1306_SetByte(i, SSD1306_Screen.Buffer[i] | (1 << (y % 8)));
+    } else {
+        ssd1306_SetByte(i, SSD1306_Screen.Buffer[i] & ~(1 << (y % 8)));
     }
 }
 
-// Draw 1 char to the screen buffer
-// ch       => char om weg te schrijven
-// Font     => Font waarmee we gaan schrijven
-// color    => Black or White
-char ssd1306_WriteChar(char ch, FontDef Font, SSD1306_COLOR color) {
-    uint32_t i, b, j;
-    
-    // Check if character is valid
-    if (ch < 32 || ch > 126)
-        return 0;
-    
-    // Check remaining space on current line
-    if (SSD1306_WIDTH < (SSD1306.CurrentX + Font.FontWidth) ||
-        SSD1306_HEIGHT < (SSD1306.CurrentY + Font.FontHeight))
-    {
-        // Not enough space on current line
-        return 0;
+// Blend width glyph bytes into a page of the screenbuffer, hi shifted down
+// to the row inside the page and lo, the glyph page above, shifted up. The
+// edge pages of a cell take only one of them, a constant 0 flag drops the
+// other from the loop. Return the changed bits of all the bytes.
+static inline uint8_t ssd1306_BlitPage(uint8_t* dst, const uint8_t* hi, const uint8_t* lo,
+                                       uint8_t use_hi, uint8_t use_lo, uint8_t width,
+                                       uint8_t shift, uint8_t mask, uint8_t invert) {
+    uint8_t changed = 0;
+    uint8_t b, d;
+    uint32_t c;
+
+    for(c = 0; c < width; c++) {
+        d = dst[c];
+        b = invert;
+        if(use_hi) {
+            b ^= hi[c] << shift;
+        }
+        if(use_lo) {
+            b ^= lo[c] >> (8 - shift);
+        }
+        b = (d ^ b) & mask;
+        dst[c] = d ^ b;
+        changed |= b;
     }
-    
-    // Use the font to write
-    for(i = 0; i < Font.FontHeight; i++) {
-        b = Font.data[(ch - 32) * Font.FontHeight + i];
-        for(j = 0; j < Font.FontWidth; j++) {
-            if((b << j) & 0x8000)  {
-                ssd1306_DrawPixel(SSD1306.CurrentX + j, (SSD1306.CurrentY + i), (SSD1306_COLOR) color);
+
+    return changed;
+}
+
+// Copy the page packed glyphs of count chars to the screenbuffer at the
+// cursor, a char at a time. Every byte takes the low part of one glyph page
+// and the high part of the one above, shifted to the row inside the page,
+// and is masked so the pixels above and below the character cells are kept.
+// Only the changed character cells are tracked, the run marks every page
+// dirty once. The cell is at most 32 rows high.
+static void ssd1306_BlitGlyphs(const char* str, uint8_t count, const FontDef* Font, uint8_t invert) {
+    uint8_t width = Font->FontWidth;
+    uint8_t pages = (Font->FontHeight + 7) / 8;
+    uint8_t shift = SSD1306.CurrentY % 8;
+    uint8_t dst_pages = (shift + Font->FontHeight + 7) / 8;
+    uint32_t mask = Font->FontHeight < 32 ? (1UL << Font->FontHeight) - 1 : 0xFFFFFFFF;
+    uint32_t stride = width * pages;
+    uint8_t* row = &SSD1306_Screen.Buffer[(SSD1306.CurrentY / 8) * SSD1306_WIDTH];
+    uint8_t m[5], first[5], last[5];
+    const uint8_t* glyph;
+    uint8_t* dst;
+    uint8_t p, k, x, changed;
+
+    for(p = 0; p < dst_pages; p++) {
+        m[p] = (p == 0) ? mask << shift : mask >> (8 * p - shift);
+        first[p] = SSD1306_WIDTH;
+    }
+
+    for(k = 0, x = SSD1306.CurrentX; k < count; k++, x += width) {
+        glyph = &Font->paged[(str[k] - 32) * stride];
+
+        for(p = 0, dst = &row[x]; p < dst_pages; p++, dst += SSD1306_WIDTH) {
+            if(p == 0) {
+                // The top page, also every page of an unshifted glyph
+                changed = ssd1306_BlitPage(dst, glyph, NULL, 1, 0, width, shift, m[p], invert);
+            } else if(p < pages) {
+                changed = ssd1306_BlitPage(dst, &glyph[p * width], &glyph[(p - 1) * width], 1, 1,
+                                           width, shift, m[p], invert);
             } else {
-                ssd1306_DrawPixel(SSD1306.CurrentX + j, (SSD1306.CurrentY + i), (SSD1306_COLOR)!color);
+                // Below the glyph, only the rows shifted out of its last page
+                changed = ssd1306_BlitPage(dst, NULL, &glyph[(p - 1) * width], 0, 1,
+                                           width, shift, m[p], invert);
+            }
+
+            if(changed) {
+                if(first[p] == SSD1306_WIDTH) {
+                    first[p] = x;
+                }
+                last[p] = x + width - 1;
             }
         }
     }
-    
+
+    for(p = 0; p < dst_pages; p++) {
+        if(first[p] < SSD1306_WIDTH) {
+            ssd1306_MarkDirty(first[p], SSD1306.CurrentY / 8 + p);
+            ssd1306_MarkDirty(last[p], SSD1306.CurrentY / 8 + p);
+        }
+    }
+
     // The current space is now taken
-    SSD1306.CurrentX += Font.FontWidth;
-    
-    // Return written char for validation
-    return ch;
+    SSD1306.CurrentX += count * width;
 }
 
-// Write full string to screenbuffer
-char ssd1306_WriteString(char* str, FontDef Font, SSD1306_COLOR color) {
-    // Write until null-byte
-    while (*str) {
-        if (ssd1306_WriteChar(*str, Font, color) != *str) {
-            // Char could not be written
-            return *str;
+// Draw the chars of str up to the first invalid one or the first one that
+// does not fit on the current line, return that char or 0 for all of them
+static char ssd1306_PutChars(const char* str, const FontDef* Font, SSD1306_COLOR color) {
+    uint32_t i, b, j;
+    uint8_t count, fit;
+
+    // Check the height once and how many chars fit on the current line
+    if (SSD1306_HEIGHT < (SSD1306.CurrentY + Font->FontHeight))
+        return *str;
+    fit = SSD1306.CurrentX < SSD1306_WIDTH ? (SSD1306_WIDTH - SSD1306.CurrentX) / Font->FontWidth : 0;
+    for (count = 0; count < fit && str[count] >= 32 && str[count] <= 126; count++)
+        ;
+
+    // Use the font to write, page packed glyphs go a byte at a time
+    if(Font->paged && Font->FontHeight <= 32) {
+        if(count) {
+            ssd1306_BlitGlyphs(str, count, Font,
+                               (color == White) == !SSD1306.Inverted ? 0x00 : 0xFF);
         }
-        
-        // Next char
-        str++;
+        return str[count];
     }
-    
-    // Everything ok
+
+    for(; count; count--, str++) {
+        for(i = 0; i < Font->FontHeight; i++) {
+            b = Font->data[(*str - 32) * Font->FontHeight + i];
+            for(j = 0; j < Font->FontWidth; j++) {
+                if((b << j) & 0x8000)  {
+                    ssd1306_DrawPixel(SSD1306.CurrentX + j, (SSD1306.CurrentY + i), (SSD1306_COLOR) color);
+                } else {
+                    ssd1306_DrawPixel(SSD1306.CurrentX + j, (SSD1306.CurrentY + i), (SSD1306_COLOR)!color);
+                }
+            }
+        }
+
+        // The current space is now taken
+        SSD1306.CurrentX += Font->FontWidth;
+    }
+
     return *str;
 }
 
+// Draw 1 char to the screen buffer
+// ch       => char om weg te schrijven
+// Font     => Font waarmee we gaan schrijven
+// color    => Black or White
+char ssd1306_WriteChar(char ch, FontDef Font, SSD1306_COLOR color) {
+    const char str[2] = { ch, 0 };
+
+    // Return written char for validation
+    return ssd1306_PutChars(str, &Font, color) ? 0 : ch;
+}
+
+// Write full string to screenbuffer, return the first char not written or
+// the null-byte when everything is ok
+char ssd1306_WriteString(char* str, FontDef Font, SSD1306_COLOR color) {
+    return ssd1306_PutChars(str, &Font, color);
+}
+
 // Position the cursor
 void ssd1306_SetCursor(uint8_t x, uint8_t y) {
     SSD1306.CurrentX = x;
     SSD1306.CurrentY = y;
 }
 
-// Draw line by Bresenhem's algorithm
+// Byte operations of the span primitives
+#define SSD1306_SPAN_CLEAR  0
+#define SSD1306_SPAN_SET    1
+#define SSD1306_SPAN_INVERT 2
+
+// Apply an operation to the rows of mask in columns x..x+w-1 of a page.
+// Every operation is (byte & keep | set) ^ flip, the unchanged columns at
+// both ends are skipped first so only the changed ones are marked dirty.
+static void ssd1306_Span(uint8_t x, uint8_t w, uint8_t page, uint8_t mask, uint8_t op) {
+    uint8_t *dst = &SSD1306_Screen.Buffer[page * SSD1306_WIDTH + x];
+    uint8_t keep = op == SSD1306_SPAN_CLEAR ? ~mask : 0xFF;
+    uint8_t set = op == SSD1306_SPAN_SET ? mask : 0x00;
+    uint8_t flip = op == SSD1306_SPAN_INVERT ? mask : 0x00;
+    uint8_t first, last, c;
+
+    for(first = 0; first < w && (((dst[first] & keep) | set) ^ flip) == dst[first]; first++);
+    if(first == w) {
+        return;
+    }
+    for(last = w - 1; (((dst[last] & keep) | set) ^ flip) == dst[last]; last--);
+
+    for(c = first; c <= last; c++) {
+        dst[c] = ((dst[c] & keep) | set) ^ flip;
+    }
+
+    ssd1306_MarkDirty(x + first, page);
+    ssd1306_MarkDirty(x + last, page);
+}
+
+// Apply an operation to a rectangle a page byte at a time, clipped to the screen
+static void ssd1306_Rect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t op) {
+    uint8_t page, last_page, mask;
+
+    if(x >= SSD1306_WIDTH || y >= SSD1306_HEIGHT || !w || !h) {
+        return;
+    }
+    if(w > SSD1306_WIDTH - x) {
+        w = SSD1306_WIDTH - x;
+    }
+    if(h > SSD1306_HEIGHT - y) {
+        h = SSD1306_HEIGHT - y;
+    }
+
+    last_page = (y + h - 1) / 8;
+    for(page = y / 8; page <= last_page; page++) {
+        mask = 0xFF;
+        if(page == y / 8) {
+            mask &= 0xFF << (y % 8);
+        }
+        if(page == last_page) {
+            mask &= 0xFF >> (7 - (y + h - 1) % 8);
+        }
+        ssd1306_Span(x, w, page, mask, op);
+    }
+}
+
+static uint8_t ssd1306_ColorOp(SSD1306_COLOR color) {
+    // Same inversion as ssd1306_DrawPixel()
+    if(SSD1306.Inverted) {
+        color = (SSD1306_COLOR)!color;
+    }
+    return color == White ? SSD1306_SPAN_SET : SSD1306_SPAN_CLEAR;
+}
+
+// Draw a horizontal line of w pixels from x,y to the right
+void ssd1306_HLine(uint8_t x, uint8_t y, uint8_t w, SSD1306_COLOR color) {
+    ssd1306_Rect(x, y, w, 1, ssd1306_ColorOp(color));
+}
+
+// Draw a vertical line of h pixels from x,y down
+void ssd1306_VLine(uint8_t x, uint8_t y, uint8_t h, SSD1306_COLOR color) {
+    ssd1306_Rect(x, y, 1, h, ssd1306_ColorOp(color));
+}
+
+// Fill a rectangle of w x h pixels with its top left corner at x,y
+void ssd1306_FillRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, SSD1306_COLOR color) {
+    ssd1306_Rect(x, y, w, h, ssd1306_ColorOp(color));
+}
+
+// Invert every pixel of a rectangle of w x h pixels with its top left corner at x,y
+void ssd1306_InvertRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h) {
+    ssd1306_Rect(x, y, w, h, SSD1306_SPAN_INVERT);
+}
+
+// Draw line by Bresenhem's algorithm, the axis aligned ones as spans
 void ssd1306_Line(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, SSD1306_COLOR color) {
+  // Clip the far end first, the length has to fit the uint8_t
+  if(y1 == y2) {
+    uint8_t lo = x1 < x2 ? x1 : x2;
+    uint8_t hi = x1 < x2 ? x2 : x1;
+    if(hi >= SSD1306_WIDTH) {
+      hi = SSD1306_WIDTH - 1;
+    }
+    if(lo <= hi) {
+      ssd1306_HLine(lo, y1, hi - lo + 1, color);
+    }
+    return;
+  }
+  if(x1 == x2) {
+    uint8_t lo = y1 < y2 ? y1 : y2;
+    uint8_t hi = y1 < y2 ? y2 : y1;
+    if(hi >= SSD1306_HEIGHT) {
+      hi = SSD1306_HEIGHT - 1;
+    }
+    if(lo <= hi) {
+      ssd1306_VLine(x1, lo, hi - lo + 1, color);
+    }
+    return;
+  }
+
   int32_t deltaX = abs(x2 - x1);
   int32_t deltaY = abs(y2 - y1);
   int32_t signX = ((x1 < x2) ? 1 : -1);
@@ -446,20 +793,18 @@ void ssd1306_DrawRectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, SSD13
 
 void ssd1306_SetContrast(const uint8_t value) {
     const uint8_t kSetContrastControlRegister = 0x81;
-    ssd1306_WriteCommand(kSetContrastControlRegister);
-    ssd1306_WriteCommand(value);
+    const uint8_t cmds[] = { kSetContrastControlRegister, value };
+    ssd1306_WriteCommands(cmds, sizeof(cmds));
 }
 
 void ssd1306_SetDisplayOn(const uint8_t on) {
-    uint8_t value;
     if (on) {
-        value = 0xAF;   // Display on
+        ssd1306_WriteCommands(ssd1306_DisplayOnCmds, sizeof(ssd1306_DisplayOnCmds));
         SSD1306.DisplayOn = 1;
     } else {
-        value = 0xAE;   // Display off
+        ssd1306_WriteCommands(ssd1306_DisplayOffCmds, sizeof(ssd1306_DisplayOffCmds));
         SSD1306.DisplayOn = 0;
     }
-    ssd1306_WriteCommand(value);
 }
 
 uint8_t ssd1306_GetDisplayOn() {
@@ -86,6 +86,11 @@ typedef enum {
     White = 0x01  // Pixel is set. Color depends on OLED
 } SSD1306_COLOR;
 
+typedef enum {
+    SSD1306_FLUSH_DIRTY = 0x00, // Dirty spans of every page, in short chunks
+    SSD1306_FLUSH_BURST = 0x01  // Whole frame in one window, in short chunks
+} SSD1306_FLUSH_MODE;
+
 typedef enum {
     SSD1306_OK = 0x00,
     SSD1306_ERR = 0x01  // Generic error.
@@ -98,16 +103,26 @@ typedef struct {
     uint8_t Inverted;
     uint8_t Initialized;
     uint8_t DisplayOn;
+    SSD1306_FLUSH_MODE FlushMode;
+    uint32_t FrameTime;
 } SSD1306_t;
 typedef struct {
     uint8_t x;
     uint8_t y;
 } SSD1306_VERTEX;
 
+// Screen contents and the columns of every page changed since they were sent
+typedef struct {
+    uint8_t Buffer[SSD1306_BUFFER_SIZE];
+    uint8_t DirtyLo[SSD1306_HEIGHT/8];  // Clean page when lo > hi
+    uint8_t DirtyHi[SSD1306_HEIGHT/8];
+} SSD1306_Frame_t;
+
 // Procedure definitions
 void ssd1306_Init(void);
 void ssd1306_Fill(SSD1306_COLOR color);
 void ssd1306_UpdateScreen(void);
+void ssd1306_Invalidate(void);
 void ssd1306_DrawPixel(uint8_t x, uint8_t y, SSD1306_COLOR color);
 char ssd1306_WriteChar(char ch, FontDef Font, SSD1306_COLOR color);
 char ssd1306_WriteString(char* str, FontDef Font, SSD1306_COLOR color);
@@ -117,6 +132,10 @@ void ssd1306_DrawArc(uint8_t x, uint8_t y, uint8_t radius, uint16_t start_angle,
 void ssd1306_DrawCircle(uint8_t par_x, uint8_t par_y, uint8_t par_r, SSD1306_COLOR color);
 void ssd1306_Polyline(const SSD1306_VERTEX *par_vertex, uint16_t par_size, SSD1306_COLOR color);
 void ssd1306_DrawRectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, SSD1306_COLOR color);
+void ssd1306_HLine(uint8_t x, uint8_t y, uint8_t w, SSD1306_COLOR color);
+void ssd1306_VLine(uint8_t x, uint8_t y, uint8_t h, SSD1306_COLOR color);
+void ssd1306_FillRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, SSD1306_COLOR color);
+void ssd1306_InvertRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h);
 /**
  * @brief Sets the contrast of the display.
  * @param[in] value contrast to set.
@@ -135,10 +154,36 @@ void ssd1306_SetDisplayOn(const uint8_t on);
  *          1: ON.
  */
 uint8_t ssd1306_GetDisplayOn();
+/**
+ * @brief Selects how ssd1306_UpdateScreen() sends the screenbuffer.
+ * @param[in] mode SSD1306_FLUSH_DIRTY (default) or SSD1306_FLUSH_BURST.
+ * @note A burst sets the window up once and sends the whole frame, in the
+ *       same short chunks as the dirty spans.
+ */
+void ssd1306_SetFlushMode(SSD1306_FLUSH_MODE mode);
+/**
+ * @brief Duration of the last ssd1306_UpdateScreen() that sent anything.
+ * @return  Frame time in microseconds.
+ */
+uint32_t ssd1306_GetFrameTime(void);
+/**
+ * @brief Copies the changes of the screenbuffer to another frame.
+ * @param[in] frame Frame to update, sent later with ssd1306_UpdateFrame().
+ * @note The screenbuffer is clean afterwards, the changes not yet sent
+ *       from the frame are kept.
+ */
+void ssd1306_CopyFrame(SSD1306_Frame_t* frame);
+/**
+ * @brief Sends the changes of a frame to the screen, like
+ *        ssd1306_UpdateScreen() does for the screenbuffer.
+ * @param[in] frame Frame to send, clean afterwards.
+ */
+void ssd1306_UpdateFrame(SSD1306_Frame_t* frame);
 
 // Low-level procedures
 void ssd1306_Reset(void);
 void ssd1306_WriteCommand(uint8_t byte);
+void ssd1306_WriteCommands(const uint8_t* cmds, size_t count);
 void ssd1306_WriteData(uint8_t* buffer, size_t buff_size);
 SSD1306_Error_t ssd1306_FillBuffer(uint8_t* buf, uint32_t len);
 
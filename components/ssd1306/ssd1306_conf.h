@@ -13,6 +13,10 @@
 // I2C Configuration
 #define SSD1306_I2C_PORT        0
 #define SSD1306_I2C_ADDR        0x3C
+// Largest I2C transaction, the ADC can get the bus between two chunks
+#define SSD1306_I2C_CHUNK       16
+// Chunks queued to the bus at once, below the i2cdev arbiter queue length
+#define SSD1306_I2C_INFLIGHT    4
 
 // SPI Configuration
 //#define SSD1306_SPI_PORT        hspi1
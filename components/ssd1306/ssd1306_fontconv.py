@@ -0,0 +1,85 @@
+#!/usr/bin/env python
+#
+# Converts the row-major uint16_t font tables of ssd1306_fonts.c to the page
+# layout of the display RAM: for every glyph and every 8 row page one byte per
+# column, the top row in bit 0. ssd1306_WriteChar() copies these bytes to the
+# screenbuffer instead of drawing pixel by pixel.
+#
+# python ssd1306_fontconv.py ssd1306_fonts.c > ssd1306_fonts_paged.c
+#
+# component.mk runs it when ssd1306_fonts.c or this script change.
+#
+
+import re
+import sys
+
+FIRST_CHAR = 32
+LAST_CHAR = 126
+
+TABLE_RE = re.compile(r"static const uint16_t Font(\d+)x(\d+)\s*\[\]\s*=\s*\{(.*?)\};", re.S)
+VALUE_RE = re.compile(r"0x[0-9A-Fa-f]+")
+
+
+def convert(width, height, rows):
+    pages = (height + 7) // 8
+    out = []
+    for ch in range(FIRST_CHAR, LAST_CHAR + 1):
+        glyph = rows[(ch - FIRST_CHAR) * height:(ch - FIRST_CHAR + 1) * height]
+        data = []
+        for page in range(pages):
+            for x in range(width):
+                byte = 0
+                for bit in range(8):
+                    y = page * 8 + bit
+                    if y < height and (glyph[y] << x) & 0x8000:
+                        byte |= 1 << bit
+                data.append(byte)
+        out.append((ch, data))
+    return out
+
+
+def char_comment(ch):
+    # A backslash at the end of a line would continue the comment
+    return {32: "sp", 92: "backslash"}.get(ch, chr(ch))
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write("usage: %s ssd1306_fonts.c\n" % sys.argv[0])
+        return 1
+
+    with open(sys.argv[1]) as f:
+        src = f.read()
+
+    # Nothing goes to stdout before every table is converted
+    out = []
+    out.append("/*\n"
+              " * Generated by ssd1306_fontconv.py from ssd1306_fonts.c, do not edit.\n"
+              " * Every glyph is page packed like the display RAM, one byte per\n"
+              " * column for every 8 rows, the top row in bit 0.\n"
+              " */\n\n"
+              "#include \"ssd1306_fonts.h\"\n")
+
+    for m in TABLE_RE.finditer(src):
+        width, height = int(m.group(1)), int(m.group(2))
+        rows = [int(v, 16) for v in VALUE_RE.findall(m.group(3))]
+        if len(rows) != (LAST_CHAR - FIRST_CHAR + 1) * height:
+            sys.stderr.write("Font%dx%d: %d rows, expected %d\n" %
+                             (width, height, len(rows), (LAST_CHAR - FIRST_CHAR + 1) * height))
+            return 1
+
+        out.append("\n#ifdef SSD1306_INCLUDE_FONT_%dx%d\n" % (width, height))
+        out.append("const uint8_t Font%dx%dPaged [] = {\n" % (width, height))
+        for ch, data in convert(width, height, rows):
+            # One line per page, the char on the first one
+            for i in range(0, len(data), width):
+                line = " ".join("0x%02X," % b for b in data[i:i + width])
+                out.append("%s  // %s\n" % (line, char_comment(ch)) if i == 0 else line + "\n")
+        out.append("};\n#endif\n")
+
+    sys.stdout.write("".join(out))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
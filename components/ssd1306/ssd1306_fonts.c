@@ -400,14 +400,18 @@ static const uint16_t Font6x8 [] = {
 #endif
 
 #ifdef SSD1306_INCLUDE_FONT_6x8
-FontDef Font_6x8 = {6,8,Font6x8};
+extern const uint8_t Font6x8Paged[];
+FontDef Font_6x8 = {6,8,Font6x8,Font6x8Paged};
 #endif
 #ifdef SSD1306_INCLUDE_FONT_7x10
-FontDef Font_7x10 = {7,10,Font7x10};
+extern const uint8_t Font7x10Paged[];
+FontDef Font_7x10 = {7,10,Font7x10,Font7x10Paged};
 #endif
 #ifdef SSD1306_INCLUDE_FONT_11x18
-FontDef Font_11x18 = {11,18,Font11x18};
+extern const uint8_t Font11x18Paged[];
+FontDef Font_11x18 = {11,18,Font11x18,Font11x18Paged};
 #endif
 #ifdef SSD1306_INCLUDE_FONT_16x26
-FontDef Font_16x26 = {16,26,Font16x26};
+extern const uint8_t Font16x26Paged[];
+FontDef Font_16x26 = {16,26,Font16x26,Font16x26Paged};
 #endif
@@ -9,6 +9,7 @@ typedef struct {
 	const uint8_t FontWidth;    /*!< Font width in pixels */
 	uint8_t FontHeight;   /*!< Font height in pixels */
 	const uint16_t *data; /*!< Pointer to data font data array */
+	const uint8_t *paged; /*!< Same glyphs page packed, see ssd1306_fontconv.py, or NULL */
 } FontDef;
 
 #ifdef SSD1306_INCLUDE_FONT_6x8
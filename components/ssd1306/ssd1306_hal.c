@@ -1,11 +1,14 @@
 
 
+#include <string.h>
+
+#include <esp_timer.h>
+#include <esp_log.h>
 #include "driver/i2c.h"
 #include "freertos/task.h"
+#include "i2cdev.h"
 #include "ssd1306_hal.h"
 
-#define ACK_CHECK_EN 1
- 
 void HAL_Delay(int ms)
 {
     int ticks = ms / portTICK_RATE_MS;
@@ -24,22 +27,90 @@ uint32_t HAL_GetTickRate()
     return xPortGetTickRateHz();
 }
 
+uint32_t HAL_GetMicros()
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
 #if defined(SSD1306_USE_I2C)
+static const char *TAG = "ssd1306";
+
+/*
+ * Goes through i2cdev as low priority traffic, split in SSD1306_I2C_CHUNK
+ * byte transactions. Every chunk starts with the control byte and the
+ * display keeps its address pointer in between. The port is set up by the
+ * ADC before and the i2cdev timeout applies.
+ * Up to SSD1306_I2C_INFLIGHT chunks are queued at once, so they go out back
+ * to back while the caller only wakes up for a free request. All of them are
+ * done on return, the data belongs to the caller.
+ */
 void HAL_I2C_Mem_Write(int i2c_num, uint8_t addr, uint8_t reg, uint8_t res,
                        uint8_t * data, int data_len, int delay)
 {
-    int ret;
-
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_WRITE, ACK_CHECK_EN);
-    i2c_master_write_byte(cmd, reg, ACK_CHECK_EN);
-    i2c_master_write(cmd, data, data_len, ACK_CHECK_EN);
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(i2c_num, cmd, delay / portTICK_RATE_MS);
-    i2c_cmd_link_delete(cmd);
-
-    if (ret != ESP_OK)
-        printf("I2C transfer filed!\n");
+    i2cdev_req_t reqs[SSD1306_I2C_INFLIGHT];
+    i2cdev_req_t *req;
+    esp_err_t err = ESP_OK, ret;
+    int len, n = 0, i;
+
+    while (data_len > 0)
+    {
+        req = &reqs[n % SSD1306_I2C_INFLIGHT];
+        if (n >= SSD1306_I2C_INFLIGHT && (err = i2cdev_wait(req, portMAX_DELAY)) != ESP_OK)
+            break;
+
+        len = data_len < SSD1306_I2C_CHUNK ? data_len : SSD1306_I2C_CHUNK;
+        memset(req, 0, sizeof(i2cdev_req_t));
+        req->port = i2c_num;
+        req->addr = addr;
+        req->prio = I2CDEV_PRIO_LOW;
+        req->reg = &reg;
+        req->reg_size = 1;
+        req->out = data;
+        req->out_size = len;
+        if ((err = i2cdev_submit(req)) != ESP_OK)
+            break;
+
+        n++;
+        data += len;
+        data_len -= len;
+    }
+
+    for (i = n > SSD1306_I2C_INFLIGHT ? n - SSD1306_I2C_INFLIGHT : 0; i < n; i++)
+    {
+        ret = i2cdev_wait(&reqs[i % SSD1306_I2C_INFLIGHT], portMAX_DELAY);
+        if (err == ESP_OK)
+            err = ret;
+    }
+
+    if (err != ESP_OK)
+        ESP_LOGE(TAG, "Could not write to display [0x%02x at %d]: %d",
+                 addr, i2c_num, err);
+}
+
+/*
+ * One start, one control byte and one stop for the whole data, meant for
+ * short command streams. The port is held for the whole transaction, frame
+ * data goes through HAL_I2C_Mem_Write() in chunks instead.
+ */
+void HAL_I2C_Mem_Write_Burst(int i2c_num, uint8_t addr, uint8_t reg,
+                             const uint8_t * data, int data_len)
+{
+    esp_err_t err = i2cdev_port_write(i2c_num, addr, I2CDEV_PRIO_LOW, &reg, 1, data, data_len);
+    if (err != ESP_OK)
+        ESP_LOGE(TAG, "Could not write to display [0x%02x at %d]: %d",
+                 addr, i2c_num, err);
+}
+
+esp_err_t HAL_I2C_Bench(int port, uint8_t addr, uint32_t stretch_tick,
+                        uint32_t count, i2cdev_bench_t *res)
+{
+    uint8_t buf[1 + SSD1306_I2C_CHUNK];
+
+    /* Command control byte, then NOPs, the display state is not changed */
+    memset(buf, 0xE3, sizeof(buf));
+    buf[0] = 0x00;
+
+    return i2cdev_bench(port, addr, stretch_tick, buf, sizeof(buf),
+                        NULL, 0, count, res);
 }
 #endif
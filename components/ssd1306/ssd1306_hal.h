@@ -7,7 +7,17 @@
 void HAL_Delay(int ms);
 uint32_t HAL_GetTick(void);
 uint32_t HAL_GetTickRate(void);
+uint32_t HAL_GetMicros(void);
 
 #if defined(SSD1306_USE_I2C)
+#include "i2cdev.h"
+
 void HAL_I2C_Mem_Write(int port, uint8_t addr, uint8_t reg, uint8_t, uint8_t * data, int size, int delay);
+
+// The whole data in one transaction, the bus is held until it is done
+void HAL_I2C_Mem_Write_Burst(int port, uint8_t addr, uint8_t reg, const uint8_t * data, int size);
+
+// Time count display chunk writes of NOP commands, see i2cdev_bench()
+esp_err_t HAL_I2C_Bench(int port, uint8_t addr, uint32_t stretch_tick,
+                        uint32_t count, i2cdev_bench_t *res);
 #endif 
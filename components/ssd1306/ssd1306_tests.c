@@ -45,23 +45,26 @@ void ssd1306_TestFonts() {
     ssd1306_UpdateScreen();
 }
 
-void ssd1306_TestFPS() {
-    ssd1306_Fill(White);
-   
+// Frames per second and average frame time of a flush mode, over 5 seconds
+static int ssd1306_TestFPSMode(SSD1306_FLUSH_MODE mode, uint32_t *frame_us) {
     uint32_t start;
     uint32_t end;
+    uint32_t frame_sum = 0;
     int fps = 0;
     char message[] = "ABCDEFGHIJK";
-   
+
+    ssd1306_SetFlushMode(mode);
+    ssd1306_Fill(White);
     ssd1306_SetCursor(2,0);
     ssd1306_WriteString("Testing...", Font_11x18, Black);
-   
+
     start = HAL_GetTick();
     do {
         ssd1306_SetCursor(2, 18);
         ssd1306_WriteString(message, Font_11x18, Black);
         ssd1306_UpdateScreen();
-       
+        frame_sum += ssd1306_GetFrameTime();
+
         char ch = message[0];
         memmove(message, message+1, sizeof(message)-2);
         message[sizeof(message)-2] = ch;
@@ -69,16 +72,35 @@ void ssd1306_TestFPS() {
         fps++;
         end = HAL_GetTick();
     } while((end - start) < 5*HAL_GetTickRate());
-   
+
+    *frame_us = frame_sum / fps;
+    return (float)fps / ((end - start) / HAL_GetTickRate());
+}
+
+void ssd1306_TestFPS() {
+    uint32_t dirty_us, burst_us;
+    int dirty_fps, burst_fps;
+    char buff[32];
+
+    dirty_fps = ssd1306_TestFPSMode(SSD1306_FLUSH_DIRTY, &dirty_us);
+    burst_fps = ssd1306_TestFPSMode(SSD1306_FLUSH_BURST, &burst_us);
+    ssd1306_SetFlushMode(SSD1306_FLUSH_DIRTY);
+
     HAL_Delay(1000);
 
-    char buff[64];
-    fps = (float)fps / ((end - start) / HAL_GetTickRate());
-    snprintf(buff, sizeof(buff), "~%d FPS", fps);
-   
     ssd1306_Fill(White);
+    snprintf(buff, sizeof(buff), "Dirty ~%d FPS", dirty_fps);
     ssd1306_SetCursor(2, 2);
-    ssd1306_WriteString(buff, Font_11x18, Black);
+    ssd1306_WriteString(buff, Font_7x10, Black);
+    snprintf(buff, sizeof(buff), "  %u us/frame", (unsigned)dirty_us);
+    ssd1306_SetCursor(2, 14);
+    ssd1306_WriteString(buff, Font_7x10, Black);
+    snprintf(buff, sizeof(buff), "Burst ~%d FPS", burst_fps);
+    ssd1306_SetCursor(2, 30);
+    ssd1306_WriteString(buff, Font_7x10, Black);
+    snprintf(buff, sizeof(buff), "  %u us/frame", (unsigned)burst_us);
+    ssd1306_SetCursor(2, 42);
+    ssd1306_WriteString(buff, Font_7x10, Black);
     ssd1306_UpdateScreen();
 }
 
@@ -0,0 +1,61 @@
+#include <string.h>
+#include "ssd1306.h"
+#include "ssd1306_text.h"
+
+void ssd1306_TextInit(SSD1306_TextRow_t* row, uint8_t x, uint8_t y, const FontDef* font, SSD1306_COLOR color) {
+    uint8_t cells = x < SSD1306_WIDTH ? (SSD1306_WIDTH - x) / font->FontWidth : 0;
+
+    row->x = x;
+    row->y = y;
+    row->font = font;
+    row->color = color;
+    row->cells = cells < SSD1306_TEXT_MAX ? cells : SSD1306_TEXT_MAX;
+    row->valid = 0;
+}
+
+void ssd1306_TextClear(SSD1306_TextRow_t* row) {
+    uint8_t i;
+
+    for(i = 0; row->valid && i < row->cells && row->text[i] == ' '; i++);
+    if(i == row->cells) {
+        return;
+    }
+
+    // A blank cell is the background color, what a space draws
+    ssd1306_FillRect(row->x, row->y, row->cells * row->font->FontWidth, row->font->FontHeight,
+                     (SSD1306_COLOR)!row->color);
+    memset(row->text, ' ', row->cells);
+    row->text[row->cells] = '\0';
+    row->valid = 1;
+}
+
+void ssd1306_TextInvalidate(SSD1306_TextRow_t* row) {
+    row->valid = 0;
+}
+
+uint8_t ssd1306_TextSet(SSD1306_TextRow_t* row, const char* str) {
+    uint8_t drawn = 0;
+    uint8_t i;
+    char ch;
+
+    for(i = 0; i < row->cells; i++) {
+        // Past the end of the text and for chars the fonts lack the cells are blank
+        ch = *str ? *str++ : ' ';
+        if(ch < 32 || ch > 126) {
+            ch = ' ';
+        }
+
+        if(row->valid && row->text[i] == ch) {
+            continue;
+        }
+
+        ssd1306_SetCursor(row->x + i * row->font->FontWidth, row->y);
+        ssd1306_WriteChar(ch, *row->font, row->color);
+        row->text[i] = ch;
+        drawn++;
+    }
+    row->text[i] = '\0';
+    row->valid = 1;
+
+    return drawn;
+}
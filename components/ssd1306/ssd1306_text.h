@@ -0,0 +1,48 @@
+#ifndef __SSD1306_TEXT_H__
+#define __SSD1306_TEXT_H__
+
+#include <_ansi.h>
+
+_BEGIN_STD_C
+
+#include "ssd1306.h"
+
+// Longest text of a row, 128 / 6 cells of the smallest font
+#define SSD1306_TEXT_MAX        21
+
+// One line of text that remembers what is on the screen. Setting a new text
+// draws only the character cells that differ, the other ones are neither
+// rendered nor marked dirty.
+typedef struct {
+    uint8_t x;
+    uint8_t y;
+    const FontDef* font;
+    SSD1306_COLOR color;
+    uint8_t cells;                      // Cells that fit on the screen
+    uint8_t valid;                      // Screen holds text, 0 after init or invalidate
+    char text[SSD1306_TEXT_MAX + 1];    // Text on the screen, padded with spaces
+} SSD1306_TextRow_t;
+
+void ssd1306_TextInit(SSD1306_TextRow_t* row, uint8_t x, uint8_t y, const FontDef* font, SSD1306_COLOR color);
+/**
+ * @brief Draws a text, only the cells different from the text on the screen.
+ * @param[in] str text, cut to the cells that fit, shorter texts clear the
+ *            remaining cells of the previous one.
+ * @return Number of cells drawn.
+ */
+uint8_t ssd1306_TextSet(SSD1306_TextRow_t* row, const char* str);
+/**
+ * @brief Blanks every cell with one ssd1306_FillRect(), no glyph is drawn.
+ *        Same as setting an empty text.
+ */
+void ssd1306_TextClear(SSD1306_TextRow_t* row);
+/**
+ * @brief Forgets the text on the screen, the next ssd1306_TextSet() draws
+ *        every cell. Needed after drawing over the row by other means, like
+ *        ssd1306_Fill().
+ */
+void ssd1306_TextInvalidate(SSD1306_TextRow_t* row);
+
+_END_STD_C
+
+#endif // __SSD1306_TEXT_H__
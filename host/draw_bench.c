@@ -0,0 +1,228 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Host benchmark for the span primitives of components/ssd1306: lines,
+ * rectangles and fills a page byte at a time next to the pixel by pixel
+ * drawing they replace. Both must leave the same frame on the simulated
+ * display, at every row offset, over a busy background.
+ *
+ * gcc -O2 -Isim -Isim/include -I../components/i2cdev -I../components/ssd1306 \
+ *     -o draw_bench draw_bench.c sim/sim_bus.c sim/i2cdev_sim.c sim/sim_ssd1306.c \
+ *     ../components/ssd1306/ssd1306.c ../components/ssd1306/ssd1306_fonts.c \
+ *     ../components/ssd1306/ssd1306_fonts_paged.c ../components/ssd1306/ssd1306_hal.c \
+ *     ../components/ssd1306/ssd1306_text.c -lm
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "i2cdev.h"
+#include "ssd1306.h"
+#include "ssd1306_text.h"
+#include "sim_bus.h"
+#include "sim_ssd1306.h"
+
+#define BENCH_OPS                      (1 << 15)
+
+static sim_ssd1306_t oled_model;
+static uint8_t background[SSD1306_BUFFER_SIZE];
+static uint8_t slow[SIM_SSD1306_PAGES][SIM_SSD1306_WIDTH];
+static uint8_t fast[SIM_SSD1306_PAGES][SIM_SSD1306_WIDTH];
+static int errors;
+
+/* The per pixel way, what ssd1306_Line() did for any line */
+static void pixel_rect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, SSD1306_COLOR color)
+{
+    uint8_t i, j;
+
+    for (j = 0; j < h; j++)
+        for (i = 0; i < w; i++)
+            ssd1306_DrawPixel(x + i, y + j, color);
+}
+
+static void pixel_outline(uint8_t x, uint8_t y, uint8_t w, uint8_t h, SSD1306_COLOR color)
+{
+    pixel_rect(x, y, w, 1, color);
+    pixel_rect(x, y + h - 1, w, 1, color);
+    pixel_rect(x, y, 1, h, color);
+    pixel_rect(x + w - 1, y, 1, h, color);
+}
+
+/* Display RAM after a full update of the screenbuffer */
+static void snapshot(uint8_t ram[SIM_SSD1306_PAGES][SIM_SSD1306_WIDTH])
+{
+    ssd1306_Invalidate();
+    ssd1306_UpdateScreen();
+    memcpy(ram, oled_model.ram, sizeof(oled_model.ram));
+}
+
+static void expect_same(const char *what, int y, int h, int color)
+{
+    if (memcmp(slow, fast, sizeof(slow)))
+    {
+        printf("%s y %d h %d color %d: frames differ\n", what, y, h, color);
+        errors++;
+    }
+}
+
+static void compare(void)
+{
+    static const uint8_t heights[] = { 1, 2, 7, 8, 9, 17, 26 };
+    static uint8_t inverted[SSD1306_BUFFER_SIZE];
+    SSD1306_TextRow_t row;
+    size_t i, k;
+    int y, color;
+
+    for (i = 0; i < sizeof(background); i++)
+        background[i] = (uint8_t)(i * 37 + (i >> 5));
+
+    for (y = 0; y < 8; y++)
+        for (k = 0; k < sizeof(heights); k++)
+            for (color = Black; color <= White; color++)
+            {
+                ssd1306_FillBuffer(background, sizeof(background));
+                pixel_rect(5, y, 100, heights[k], color);
+                snapshot(slow);
+                ssd1306_FillBuffer(background, sizeof(background));
+                ssd1306_FillRect(5, y, 100, heights[k], color);
+                snapshot(fast);
+                expect_same("fill", y, heights[k], color);
+
+                ssd1306_FillBuffer(background, sizeof(background));
+                pixel_outline(5, y, 100, heights[k] + 1, color);
+                snapshot(slow);
+                ssd1306_FillBuffer(background, sizeof(background));
+                ssd1306_DrawRectangle(5, y, 104, y + heights[k], color);
+                snapshot(fast);
+                expect_same("rectangle", y, heights[k], color);
+            }
+
+    /* Inverting flips exactly the pixels of the rectangle */
+    for (y = 0; y < 8; y++)
+        for (k = 0; k < sizeof(heights); k++)
+        {
+            memcpy(inverted, background, sizeof(inverted));
+            for (i = 0; i < heights[k]; i++)
+                for (color = 0; color < 100; color++)
+                    inverted[(y + i) / 8 * SSD1306_WIDTH + 5 + color] ^= 1 << ((y + i) % 8);
+            ssd1306_FillBuffer(inverted, sizeof(inverted));
+            snapshot(slow);
+            ssd1306_FillBuffer(background, sizeof(background));
+            ssd1306_InvertRect(5, y, 100, heights[k]);
+            snapshot(fast);
+            expect_same("invert", y, heights[k], 0);
+        }
+
+    /* A cleared text row is an empty text */
+    ssd1306_TextInit(&row, 2, 22, &Font_11x18, White);
+    ssd1306_FillBuffer(background, sizeof(background));
+    ssd1306_TextSet(&row, "");
+    snapshot(slow);
+    ssd1306_TextInvalidate(&row);
+    ssd1306_FillBuffer(background, sizeof(background));
+    ssd1306_TextClear(&row);
+    snapshot(fast);
+    expect_same("text clear", 22, 18, White);
+}
+
+typedef void (*draw_fn_t)(int n);
+
+static void pixel_hline(int n)   { pixel_rect(10, n & 63, 100, 1, n & 64 ? White : Black); }
+static void span_hline(int n)    { ssd1306_HLine(10, n & 63, 100, n & 64 ? White : Black); }
+static void pixel_vline(int n)   { pixel_rect(n & 127, 10, 1, 40, n & 128 ? White : Black); }
+static void span_vline(int n)    { ssd1306_VLine(n & 127, 10, 40, n & 128 ? White : Black); }
+static void pixel_frame(int n)   { pixel_outline(10, n & 7, 100, 40, n & 8 ? White : Black); }
+static void span_frame(int n)    { ssd1306_DrawRectangle(10, n & 7, 109, (n & 7) + 39, n & 8 ? White : Black); }
+static void pixel_fill(int n)    { pixel_rect(10, n & 7, 100, 40, n & 8 ? White : Black); }
+static void span_fill(int n)     { ssd1306_FillRect(10, n & 7, 100, 40, n & 8 ? White : Black); }
+
+/* The old blink: a row of spaces, with the page packed font already */
+static void glyph_blank(int n)
+{
+    ssd1306_SetCursor(2, 22);
+    ssd1306_WriteString("           ", Font_11x18, n & 1 ? White : Black);
+}
+
+static void span_blank(int n)
+{
+    ssd1306_FillRect(2, 22, 11 * 11, 18, n & 1 ? Black : White);
+}
+
+static double ns_per_op(draw_fn_t fn)
+{
+    struct timespec t0, t1;
+    int n;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < BENCH_OPS; n++)
+        fn(n);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / BENCH_OPS;
+}
+
+static void cost(void)
+{
+    static const struct {
+        const char *name;
+        draw_fn_t old, span;
+    } ops[] = {
+        {"hline 100",        pixel_hline, span_hline},
+        {"vline 40",         pixel_vline, span_vline},
+        {"rectangle 100x40", pixel_frame, span_frame},
+        {"fill 100x40",      pixel_fill,  span_fill},
+        {"blank row 11x18",  glyph_blank, span_blank},
+    };
+    double old, span;
+    size_t i;
+
+    printf("%-18s %10s %10s %8s\n", "op", "old ns", "span ns", "speedup");
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+    {
+        old = ns_per_op(ops[i].old);
+        span = ns_per_op(ops[i].span);
+        printf("%-18s %10.1f %10.1f %7.1fx\n", ops[i].name, old, span, old / span);
+    }
+}
+
+int main(void)
+{
+    i2c_dev_t oled = { .port = I2C_NUM_0, .addr = SSD1306_I2C_ADDR };
+    const uint8_t nop[] = { 0x00, 0xE3 };
+
+    /* The ADC sets the port up on target, a display NOP does it here */
+    i2cdev_init();
+    if (sim_ssd1306_init(&oled_model, SSD1306_I2C_ADDR) != ESP_OK ||
+        i2c_dev_write(&oled, NULL, 0, nop, sizeof(nop)) != ESP_OK)
+        return 1;
+    ssd1306_Init();
+
+    compare();
+    cost();
+    printf("%s\n", errors ? "FAILED" : "OK");
+
+    return errors ? 1 : 0;
+}
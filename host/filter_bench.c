@@ -0,0 +1,144 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Host benchmark for main/filter.c: step response of every filter next to
+ * the old truncating "prev + (x - prev) / 5" and the cost per sample.
+ *
+ * gcc -O2 -I../main -o filter_bench filter_bench.c ../main/filter.c
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "filter.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#define STEP_FROM                      12000
+#define STEP_TO                        13493
+#define STEP_SAMPLES                   48
+#define BENCH_SAMPLES                  (1 << 22)
+
+static const struct {
+    const char *name;
+    filter_cfg_t cfg;
+} filters[] = {
+    {"none",       {FILTER_NONE, 0, 0}},
+    {"iir 1/4",    {FILTER_IIR,  2, 0}},
+    {"iir 1/16",   {FILTER_IIR,  4, 0}},
+    {"avg 8",      {FILTER_AVG,  3, 0}},
+    {"avg 16",     {FILTER_AVG,  4, 0}},
+    {"cic 3 /4",   {FILTER_CIC,  2, 3}},
+    {"cic 2 /16",  {FILTER_CIC,  4, 2}},
+};
+
+#define FILTERS_NUM (sizeof(filters) / sizeof(filters[0]))
+
+static void step_response(void)
+{
+    filter_t f[FILTERS_NUM];
+    int old = STEP_FROM;
+    int x, n;
+    size_t i;
+
+    for (i = 0; i < FILTERS_NUM; i++)
+        filter_init(&f[i], &filters[i].cfg);
+
+    printf("%4s %9s", "n", "old /5");
+    for (i = 0; i < FILTERS_NUM; i++)
+        printf(" %9s", filters[i].name);
+    printf("\n");
+
+    for (n = 0; n < STEP_SAMPLES; n++) {
+        x = n < 4 ? STEP_FROM : STEP_TO;
+        old = old + (x - old) / 5;
+
+        printf("%4d %9d", n, old);
+        for (i = 0; i < FILTERS_NUM; i++) {
+            /* Mark decimated filters that produced no output with '.' */
+            if (filter_update(&f[i], x))
+                printf(" %9d", (int)f[i].out);
+            else
+                printf(" %8d.", (int)f[i].out);
+        }
+        printf("\n");
+    }
+
+    printf("final error vs %d: old %d", STEP_TO, old - STEP_TO);
+    for (i = 0; i < FILTERS_NUM; i++)
+        printf(", %s %d", filters[i].name, (int)f[i].out - STEP_TO);
+    printf("\n\n");
+}
+
+static void cost(void)
+{
+    struct timespec t0, t1;
+    volatile int32_t sink = 0;
+    filter_t f;
+    double ns;
+    size_t i;
+    int n;
+#ifdef HAVE_TSC
+    unsigned long long c0, c1;
+#endif
+
+    printf("%-10s %10s %10s\n", "filter", "ns/sample", "cyc/sample");
+    for (i = 0; i < FILTERS_NUM; i++) {
+        filter_init(&f, &filters[i].cfg);
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+#ifdef HAVE_TSC
+        c0 = __rdtsc();
+#endif
+        for (n = 0; n < BENCH_SAMPLES; n++) {
+            filter_update(&f, STEP_FROM + (n & 0xff));
+            sink += f.out;
+        }
+#ifdef HAVE_TSC
+        c1 = __rdtsc();
+#endif
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+        printf("%-10s %10.2f", filters[i].name, ns / BENCH_SAMPLES);
+#ifdef HAVE_TSC
+        printf(" %10.2f", (double)(c1 - c0) / BENCH_SAMPLES);
+#else
+        printf(" %10s", "n/a");
+#endif
+        printf("\n");
+    }
+}
+
+int main(void)
+{
+    step_response();
+    cost();
+
+    return 0;
+}
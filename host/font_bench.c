@@ -0,0 +1,185 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Host benchmark for the glyph rendering of components/ssd1306: the page
+ * packed blitter of ssd1306_WriteChar() next to the pixel by pixel path the
+ * same fonts take without their paged data. Both must leave the same frame
+ * on the simulated display, at every row offset, over a busy background, and
+ * the blitter must be at least MIN_SPEEDUP times faster for every font.
+ *
+ * gcc -O2 -Isim -Isim/include -I../components/i2cdev -I../components/ssd1306 \
+ *     -o font_bench font_bench.c sim/sim_bus.c sim/i2cdev_sim.c sim/sim_ssd1306.c \
+ *     ../components/ssd1306/ssd1306.c ../components/ssd1306/ssd1306_fonts.c \
+ *     ../components/ssd1306/ssd1306_fonts_paged.c ../components/ssd1306/ssd1306_hal.c -lm
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "i2cdev.h"
+#include "ssd1306.h"
+#include "sim_bus.h"
+#include "sim_ssd1306.h"
+
+#define TEXT                           "Bat: 12.61V"
+#define BENCH_CHARS                    (1 << 17)
+#define BENCH_RUNS                     7
+#define MIN_SPEEDUP                    10.0
+
+static const struct {
+    const char *name;
+    FontDef *font;
+} fonts[] = {
+    {"6x8",   &Font_6x8},
+    {"7x10",  &Font_7x10},
+    {"11x18", &Font_11x18},
+    {"16x26", &Font_16x26},
+};
+
+#define FONTS_NUM (sizeof(fonts) / sizeof(fonts[0]))
+
+static sim_ssd1306_t oled_model;
+static uint8_t background[SSD1306_BUFFER_SIZE];
+
+/* The same font without its paged data, drawn pixel by pixel */
+static FontDef pixel_font(const FontDef *font)
+{
+    FontDef f = { font->FontWidth, font->FontHeight, font->data, NULL };
+
+    return f;
+}
+
+/* Render on the background and return the display RAM after a full update */
+static void render(FontDef font, uint8_t y, SSD1306_COLOR color,
+                   uint8_t ram[SIM_SSD1306_PAGES][SIM_SSD1306_WIDTH])
+{
+    ssd1306_FillBuffer(background, sizeof(background));
+    ssd1306_SetCursor(3, y);
+    ssd1306_WriteString(TEXT, font, color);
+    ssd1306_Invalidate();
+    ssd1306_UpdateScreen();
+    memcpy(ram, oled_model.ram, sizeof(oled_model.ram));
+}
+
+static int compare(void)
+{
+    static uint8_t slow[SIM_SSD1306_PAGES][SIM_SSD1306_WIDTH];
+    static uint8_t fast[SIM_SSD1306_PAGES][SIM_SSD1306_WIDTH];
+    int errors = 0;
+    size_t i;
+    uint8_t y;
+    int color;
+
+    for (i = 0; i < sizeof(background); i++)
+        background[i] = (uint8_t)(i * 37 + (i >> 5));
+
+    for (i = 0; i < FONTS_NUM; i++)
+        for (y = 0; y < 8; y++)
+            for (color = Black; color <= White; color++)
+            {
+                render(pixel_font(fonts[i].font), y, color, slow);
+                render(*fonts[i].font, y, color, fast);
+                if (memcmp(slow, fast, sizeof(slow)))
+                {
+                    printf("font %s y %u color %d: frames differ\n", fonts[i].name, y, color);
+                    errors++;
+                }
+            }
+
+    return errors;
+}
+
+static double ns_per_char(FontDef font)
+{
+    struct timespec t0, t1;
+    size_t len = strlen(TEXT);
+    size_t n;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < BENCH_CHARS / len; n++)
+    {
+        ssd1306_SetCursor(0, n & 7);
+        ssd1306_WriteString(TEXT, font, n & 8 ? White : Black);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / (n * len);
+}
+
+/*
+ * Every font must be at least MIN_SPEEDUP times faster paged. Both paths take
+ * their best of BENCH_RUNS interleaved runs, the other tasks of the host only
+ * ever slow a run down.
+ */
+static int cost(void)
+{
+    double slow, fast, ns;
+    int errors = 0;
+    size_t i;
+    int run;
+
+    printf("%-6s %12s %12s %8s\n", "font", "pixel ns/ch", "paged ns/ch", "speedup");
+    for (i = 0; i < FONTS_NUM; i++)
+    {
+        slow = fast = 0;
+        for (run = 0; run < BENCH_RUNS; run++)
+        {
+            ns = ns_per_char(pixel_font(fonts[i].font));
+            if (run == 0 || ns < slow)
+                slow = ns;
+            ns = ns_per_char(*fonts[i].font);
+            if (run == 0 || ns < fast)
+                fast = ns;
+        }
+
+        printf("%-6s %12.1f %12.1f %7.1fx%s\n", fonts[i].name, slow, fast, slow / fast,
+               slow / fast < MIN_SPEEDUP ? "  below target" : "");
+        if (slow / fast < MIN_SPEEDUP)
+            errors++;
+    }
+
+    return errors;
+}
+
+int main(void)
+{
+    i2c_dev_t oled = { .port = I2C_NUM_0, .addr = SSD1306_I2C_ADDR };
+    const uint8_t nop[] = { 0x00, 0xE3 };
+    int errors;
+
+    /* The ADC sets the port up on target, a display NOP does it here */
+    i2cdev_init();
+    if (sim_ssd1306_init(&oled_model, SSD1306_I2C_ADDR) != ESP_OK ||
+        i2c_dev_write(&oled, NULL, 0, nop, sizeof(nop)) != ESP_OK)
+        return 1;
+    ssd1306_Init();
+
+    errors = compare();
+    errors += cost();
+    printf("%s\n", errors ? "FAILED" : "OK");
+
+    return errors ? 1 : 0;
+}
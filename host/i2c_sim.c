@@ -0,0 +1,361 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Host run of the ads111x and ssd1306 drivers on the simulated I2C backend
+ * in host/sim: an ADS1115 register model with the UPS inputs and an SSD1306
+ * model decoding into its display RAM. Checks the readings and the frame
+ * against the models and prints the I2C transactions, bytes and bus time
+ * of every step. Exits with 1 on a mismatch.
+ *
+ * gcc -O2 -Isim -Isim/include -I../components/i2cdev -I../components/ads111x \
+ *     -I../components/ssd1306 -o i2c_sim i2c_sim.c sim/sim_bus.c sim/i2cdev_sim.c \
+ *     sim/sim_ads1115.c sim/sim_ssd1306.c ../components/ads111x/ads111x.c \
+ *     ../components/ssd1306/ssd1306.c ../components/ssd1306/ssd1306_fonts.c \
+ *     ../components/ssd1306/ssd1306_fonts_paged.c ../components/ssd1306/ssd1306_hal.c \
+ *     ../components/ssd1306/ssd1306_text.c -lm
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "i2cdev.h"
+#include "ads111x.h"
+#include "ssd1306.h"
+#include "ssd1306_text.h"
+#include "sim_bus.h"
+#include "sim_ads1115.h"
+#include "sim_ssd1306.h"
+
+#define ADC_ADDR                       ADS111X_ADDR_GND
+#define PIPELINE_SAMPLES               64
+#define BENCH_COUNT                    100
+
+/* Divider outputs of the UPS inputs, see the channel table in main/ups.c */
+static const struct {
+    const char *name;
+    ads111x_mux_t mux;
+    sim_wave_t wave;
+} chans[] = {
+    {"v_bat", ADS111X_MUX_0_GND, {1.435, 0.0,   0.0,   0.0}},
+    {"v_out", ADS111X_MUX_1_GND, {1.113, 0.004, 100.0, 0.0}},
+    {"v_in",  ADS111X_MUX_2_GND, {0.812, 0.0,   0.0,   0.0}},
+    {"i_out", ADS111X_MUX_3_GND, {0.050, 0.0,   0.0,   0.0}},
+};
+
+#define CHANS_NUM (sizeof(chans) / sizeof(chans[0]))
+
+static sim_ads1115_t adc_model;
+static sim_ssd1306_t oled_model;
+static i2c_dev_t adc;
+static int failed;
+
+static sim_bus_stats_t bus_mark;
+
+static void step_begin(void)
+{
+    sim_bus_get_stats(0, &bus_mark);
+}
+
+static void step_end(const char *name, uint32_t count)
+{
+    sim_bus_stats_t s;
+
+    sim_bus_get_stats(0, &s);
+    s.transactions -= bus_mark.transactions;
+    s.bytes_out -= bus_mark.bytes_out;
+    s.bytes_in -= bus_mark.bytes_in;
+    s.bus_us -= bus_mark.bus_us;
+
+    printf("%-28s %6u trans %7u out %6u in %8llu us",
+           name, s.transactions, s.bytes_out, s.bytes_in,
+           (unsigned long long)s.bus_us);
+    if (count > 1)
+        printf("  (%.1f trans, %.0f us each)", (double)s.transactions / count,
+               (double)s.bus_us / count);
+    printf("\n");
+}
+
+static void check(bool ok, const char *fmt, ...)
+{
+    va_list args;
+
+    if (ok)
+        return;
+
+    printf("MISMATCH: ");
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    printf("\n");
+    failed = 1;
+}
+
+/* Conversion result the model gives for chan at the gain 2.048 V */
+static int expected(int chan)
+{
+    return (int)(chans[chan].wave.dc * 32768.0 / 2.048 + 0.5);
+}
+
+static void adc_single_shot(void)
+{
+    bool busy;
+    int16_t raw;
+    size_t i;
+
+    ads111x_set_mode(&adc, ADS111X_MODE_SINGLE_SHOT);
+    ads111x_set_data_rate(&adc, ADS111X_DATA_RATE_860);
+
+    step_begin();
+    for (i = 0; i < CHANS_NUM; i++)
+    {
+        ads111x_set_input(&adc, chans[i].mux, ADS111X_GAIN_2V048, true);
+        do {
+            vTaskDelay(1);
+            ads111x_is_busy(&adc, &busy);
+        } while (busy);
+        ads111x_get_value(&adc, &raw);
+
+        if (chans[i].wave.amp == 0.0)
+            check(raw == expected(i), "single shot raw %d expected %d", raw, expected(i));
+    }
+    step_end("single shot, 4 channels", CHANS_NUM);
+}
+
+/*
+ * The continuous scan of main/adc.c: program the mux of the next channel
+ * while the current one converts, then read it on the ready pulse.
+ */
+static void adc_pipeline(void)
+{
+    int16_t raw;
+    int cur = 0, next, n;
+    uint64_t rdy;
+
+    ads111x_set_input(&adc, chans[cur].mux, ADS111X_GAIN_2V048, false);
+    ads111x_set_comp_high_thresh(&adc, (int16_t)0x8000);
+    ads111x_set_comp_low_thresh(&adc, 0);
+    ads111x_set_comp_queue(&adc, ADS111X_COMP_QUEUE_1);
+    ads111x_set_mode(&adc, ADS111X_MODE_CONTINUOUS);
+
+    /* The first conversion runs with the mux set above */
+    step_begin();
+    for (n = 0; n < PIPELINE_SAMPLES; n++)
+    {
+        next = (cur + 1) % CHANS_NUM;
+        ads111x_set_input(&adc, chans[next].mux, ADS111X_GAIN_2V048, false);
+
+        rdy = sim_ads1115_next_rdy(&adc_model);
+        if (rdy > sim_time_us())
+            sim_time_advance(rdy - sim_time_us());
+        check(!sim_ads1115_alert_pin(&adc_model), "no ready pulse at sample %d", n);
+
+        ads111x_get_value(&adc, &raw);
+
+        if (chans[cur].wave.amp == 0.0)
+            check(raw == expected(cur), "pipeline raw %d expected %d", raw, expected(cur));
+        cur = next;
+    }
+    step_end("continuous scan samples", PIPELINE_SAMPLES);
+
+    printf("%-28s %6u conversions %u ready pulses\n", "", adc_model.conversions,
+           adc_model.rdy_pulses);
+
+    ads111x_set_mode(&adc, ADS111X_MODE_SINGLE_SHOT);
+}
+
+static void oled_frame(void)
+{
+    static uint8_t pattern[SSD1306_BUFFER_SIZE];
+    static uint8_t ram[sizeof(oled_model.ram)];
+    static SSD1306_Frame_t front;
+    SSD1306_TextRow_t row;
+    uint8_t cells;
+    int x, y, errors = 0;
+    size_t i;
+
+    step_begin();
+    ssd1306_Init();
+    step_end("ssd1306_Init", 1);
+
+    step_begin();
+    ssd1306_Fill(Black);
+    ssd1306_SetCursor(2, 4);
+    ssd1306_WriteString("12V UPS", Font_16x26, White);
+    ssd1306_SetCursor(2, 40);
+    ssd1306_WriteString("FW: host", Font_11x18, White);
+    ssd1306_UpdateScreen();
+    step_end("ssd1306_UpdateScreen", 1);
+
+    sim_ssd1306_dump(&oled_model, stdout);
+
+    /* Every byte of a known buffer must land at its place in the RAM */
+    for (i = 0; i < sizeof(pattern); i++)
+        pattern[i] = (uint8_t)(i * 7 + (i >> 7));
+    ssd1306_FillBuffer(pattern, sizeof(pattern));
+    ssd1306_UpdateScreen();
+
+    for (y = 0; y < SSD1306_HEIGHT / 8; y++)
+        for (x = 0; x < SSD1306_WIDTH; x++)
+            errors += oled_model.ram[y][x] != pattern[y * SSD1306_WIDTH + x];
+    check(!errors, "frame has %d wrong bytes of %d", errors, SSD1306_BUFFER_SIZE);
+
+    /* A status refresh where one digit changes sends only its columns */
+    ssd1306_Fill(Black);
+    ssd1306_SetCursor(2, 22);
+    ssd1306_WriteString("Bat: 12.61V", Font_11x18, White);
+    ssd1306_UpdateScreen();
+
+    step_begin();
+    ssd1306_SetCursor(2, 22);
+    ssd1306_WriteString("Bat: 12.62V", Font_11x18, White);
+    ssd1306_UpdateScreen();
+    step_end("ssd1306 one digit update", 1);
+
+    /* The partial updates must leave the same RAM as a full one */
+    memcpy(ram, oled_model.ram, sizeof(ram));
+    ssd1306_Invalidate();
+    ssd1306_UpdateScreen();
+    check(!memcmp(ram, oled_model.ram, sizeof(ram)), "partial update differs from full one");
+
+    /* A full frame in chunks per page against one window for all pages */
+    step_begin();
+    ssd1306_Invalidate();
+    ssd1306_UpdateScreen();
+    step_end("ssd1306 full frame, dirty", 1);
+    printf("%-28s %6u us\n", "  frame time", ssd1306_GetFrameTime());
+
+    ssd1306_SetFlushMode(SSD1306_FLUSH_BURST);
+    step_begin();
+    ssd1306_Invalidate();
+    ssd1306_UpdateScreen();
+    step_end("ssd1306 full frame, burst", 1);
+    printf("%-28s %6u us\n", "  frame time", ssd1306_GetFrameTime());
+    ssd1306_SetFlushMode(SSD1306_FLUSH_DIRTY);
+    check(!memcmp(ram, oled_model.ram, sizeof(ram)), "burst frame differs from dirty one");
+
+    /* Double buffered like main/display.c: changes go through a front frame */
+    memset(&front, 0, sizeof(front));
+    memset(front.DirtyLo, 0xFF, sizeof(front.DirtyLo));
+    memcpy(front.Buffer, ram, sizeof(front.Buffer));
+    ssd1306_SetCursor(2, 22);
+    ssd1306_WriteString("Bat: 12.63V", Font_11x18, White);
+    ssd1306_CopyFrame(&front);
+    step_begin();
+    ssd1306_UpdateFrame(&front);
+    step_end("ssd1306 front frame update", 1);
+    memcpy(ram, oled_model.ram, sizeof(ram));
+    ssd1306_Invalidate();
+    ssd1306_UpdateScreen();
+    check(!memcmp(ram, oled_model.ram, sizeof(ram)), "front frame differs from screenbuffer");
+
+    /* A text row redraws only the cells that differ */
+    ssd1306_Fill(Black);
+    ssd1306_TextInit(&row, 2, 22, &Font_11x18, White);
+    ssd1306_TextSet(&row, "Vbat: 12.6V");
+    ssd1306_UpdateScreen();
+    step_begin();
+    cells = ssd1306_TextSet(&row, "Vbat  12.7V");
+    ssd1306_UpdateScreen();
+    step_end("ssd1306 text row, 2 cells", 1);
+    check(cells == 2, "text row drew %u cells, expected 2", cells);
+    memcpy(ram, oled_model.ram, sizeof(ram));
+    ssd1306_SetCursor(2, 22);
+    ssd1306_WriteString("Vbat  12.7V", Font_11x18, White);
+    ssd1306_Invalidate();
+    ssd1306_UpdateScreen();
+    check(!memcmp(ram, oled_model.ram, sizeof(ram)), "text row differs from the string");
+
+    printf("%-28s %6u commands %u ignored %u unknown %u data bytes\n", "ssd1306 model",
+           oled_model.commands, oled_model.ignored, oled_model.unknown,
+           oled_model.data_bytes);
+    check(!oled_model.unknown, "%u unknown commands", oled_model.unknown);
+}
+
+static void bench(void)
+{
+    static const uint32_t rates[] = { 100000, 400000 };
+    uint8_t reg = 0, buf[2];
+    i2cdev_bench_t res;
+    size_t i;
+
+    for (i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+    {
+        /* Unlike the ESP8266 driver, the simulated bus follows the SCL rate */
+        sim_bus_set_hz(rates[i]);
+
+        i2cdev_bench(I2C_NUM_0, ADC_ADDR, 0, &reg, 1, buf, 2, BENCH_COUNT, &res);
+        printf("bench adc  %6u Hz %6u trans %4u us avg %7.1f kB/s\n", rates[i],
+               res.transactions, res.lat_avg_us, res.bytes * 1000.0 / res.elapsed_us);
+
+        HAL_I2C_Bench(SSD1306_I2C_PORT, SSD1306_I2C_ADDR, 0, BENCH_COUNT, &res);
+        printf("bench oled %6u Hz %6u trans %4u us avg %7.1f kB/s\n", rates[i],
+               res.transactions, res.lat_avg_us, res.bytes * 1000.0 / res.elapsed_us);
+    }
+    sim_bus_set_hz(0);
+}
+
+static void dev_stats(void)
+{
+    i2cdev_dev_stats_t stats[8];
+    int count = 8, i;
+
+    i2cdev_get_dev_stats(I2C_NUM_0, stats, &count, false);
+    for (i = 0; i < count; i++)
+        printf("dev 0x%02x %6u trans %7u bytes %u nack %8llu us busy\n", stats[i].addr,
+               stats[i].transactions, stats[i].bytes, stats[i].err_nack,
+               (unsigned long long)stats[i].busy_us);
+}
+
+int main(void)
+{
+    size_t i;
+
+    i2cdev_init();
+
+    if (sim_ads1115_init(&adc_model, ADC_ADDR) != ESP_OK ||
+        sim_ssd1306_init(&oled_model, SSD1306_I2C_ADDR) != ESP_OK)
+        return 1;
+    for (i = 0; i < CHANS_NUM; i++)
+        sim_ads1115_set_wave(&adc_model, i, &chans[i].wave);
+
+    memset(&adc, 0, sizeof(adc));
+    if (ads111x_init_desc(&adc, ADC_ADDR, I2C_NUM_0, 4, 5) != ESP_OK)
+        return 1;
+
+    adc_single_shot();
+    adc_pipeline();
+    printf("%-28s %6u driver transactions\n", "ads111x", ads111x_get_transactions(&adc));
+
+    oled_frame();
+    bench();
+    dev_stats();
+
+    printf("%s\n", failed ? "FAILED" : "OK");
+
+    return failed;
+}
@@ -0,0 +1,449 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * i2cdev backend for the host build: the API of components/i2cdev on top of
+ * the simulated bus of sim_bus.h, so the drivers above it run unchanged.
+ * There is no arbiter task and no command link pool, every call is one
+ * bus transaction and asynchronous requests complete before i2cdev_submit()
+ * returns. The per device counters are kept like on the target,
+ * with the simulated time.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "i2cdev.h"
+#include "sim_bus.h"
+
+/* sdkconfig defaults of components/i2cdev/Kconfig */
+#ifndef CONFIG_I2CDEV_STATS_DEVS
+#define CONFIG_I2CDEV_STATS_DEVS       6
+#endif
+
+#ifndef CONFIG_I2CDEV_CMD_BUF_SIZE
+#define CONFIG_I2CDEV_CMD_BUF_SIZE     136
+#endif
+
+static struct {
+    bool setup;
+    i2cdev_dev_stats_t dev_stats[CONFIG_I2CDEV_STATS_DEVS];
+    int dev_stats_count;
+    i2cdev_bus_stats_t bus_stats;
+} states[I2C_NUM_MAX];
+
+esp_err_t i2cdev_init()
+{
+    memset(states, 0, sizeof(states));
+
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_done()
+{
+    memset(states, 0, sizeof(states));
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_dev_create_mutex(i2c_dev_t *dev)
+{
+    if (!dev)
+        return ESP_ERR_INVALID_ARG;
+
+    dev->mutex = xSemaphoreCreateMutex();
+    if (!dev->mutex)
+        return ESP_ERR_NO_MEM;
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_dev_delete_mutex(i2c_dev_t *dev)
+{
+    if (!dev)
+        return ESP_ERR_INVALID_ARG;
+
+    vSemaphoreDelete(dev->mutex);
+    dev->mutex = NULL;
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_dev_take_mutex(i2c_dev_t *dev)
+{
+    if (!dev)
+        return ESP_ERR_INVALID_ARG;
+
+    /* Single threaded, a second take is a missing give */
+    if (!xSemaphoreTake(dev->mutex, portMAX_DELAY))
+        return ESP_ERR_TIMEOUT;
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_dev_give_mutex(i2c_dev_t *dev)
+{
+    if (!dev)
+        return ESP_ERR_INVALID_ARG;
+
+    if (!xSemaphoreGive(dev->mutex))
+        return ESP_ERR_INVALID_STATE;
+
+    return ESP_OK;
+}
+
+static void dev_stats_add(i2c_port_t port, uint8_t addr, esp_err_t res,
+                          size_t bytes, uint32_t us)
+{
+    i2cdev_dev_stats_t *s = NULL;
+    int i, b;
+
+    for (i = 0; i < states[port].dev_stats_count; i++)
+        if (states[port].dev_stats[i].addr == addr)
+            s = &states[port].dev_stats[i];
+
+    if (!s)
+    {
+        if (states[port].dev_stats_count == CONFIG_I2CDEV_STATS_DEVS)
+            return;
+        s = &states[port].dev_stats[states[port].dev_stats_count++];
+        memset(s, 0, sizeof(i2cdev_dev_stats_t));
+        s->addr = addr;
+    }
+
+    s->transactions++;
+    if (res == ESP_OK)
+        s->bytes += bytes;
+    else if (res == ESP_FAIL)
+        s->err_nack++;
+    else if (res == ESP_ERR_TIMEOUT)
+        s->err_timeout++;
+    else
+        s->err_other++;
+    s->busy_us += us;
+
+    for (b = 0; b < I2CDEV_LAT_BUCKETS - 1 && (us >> (b + 1)); b++)
+        ;
+    s->lat_hist[b]++;
+}
+
+/* Register and data go out in one write, like the command links on target */
+static esp_err_t transfer(i2c_port_t port, uint8_t addr, const void *reg,
+                          size_t reg_size, const void *out, size_t out_size,
+                          void *in, size_t in_size)
+{
+    uint8_t stack_buf[1 + CONFIG_I2CDEV_CMD_BUF_SIZE];
+    uint8_t *buf = stack_buf;
+    uint64_t start = sim_time_us();
+    esp_err_t res;
+
+    if (port >= I2C_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+    /* Past the pooled links the target builds a one-shot link */
+    if (reg_size + out_size > sizeof(stack_buf) && !(buf = malloc(reg_size + out_size)))
+        return ESP_ERR_NO_MEM;
+
+    if (reg && reg_size)
+        memcpy(buf, reg, reg_size);
+    else
+        reg_size = 0;
+    if (out && out_size)
+        memcpy(buf + reg_size, out, out_size);
+    else
+        out_size = 0;
+
+    res = sim_bus_transfer(addr, buf, reg_size + out_size, in, in && in_size ? in_size : 0);
+    dev_stats_add(port, addr, res, reg_size + out_size + in_size,
+                  (uint32_t)(sim_time_us() - start));
+
+    if (buf != stack_buf)
+        free(buf);
+
+    return res;
+}
+
+/*
+ * Segments of a batch run back to back on the model bus. The repeated starts
+ * save a stop bit each on target, close enough to ignore here.
+ */
+static esp_err_t transfer_segs(i2c_port_t port, uint8_t addr,
+                               const i2cdev_seg_t *segs, size_t count)
+{
+    uint64_t start = sim_time_us();
+    esp_err_t res = ESP_OK;
+    size_t bytes = 0;
+    size_t i;
+
+    if (port >= I2C_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    for (i = 0; i < count && res == ESP_OK; i++)
+    {
+        res = sim_bus_transfer(addr, segs[i].out, segs[i].out ? segs[i].out_size : 0,
+                               segs[i].in, segs[i].in ? segs[i].in_size : 0);
+        bytes += segs[i].out_size + segs[i].in_size;
+    }
+    dev_stats_add(port, addr, res, bytes, (uint32_t)(sim_time_us() - start));
+
+    return res;
+}
+
+static bool segs_valid(const i2cdev_seg_t *segs, size_t count)
+{
+    size_t i;
+
+    if (!segs || !count || count > I2CDEV_SEGS_MAX)
+        return false;
+    for (i = 0; i < count; i++)
+        if ((!segs[i].out || !segs[i].out_size) && (!segs[i].in || !segs[i].in_size))
+            return false;
+
+    return true;
+}
+
+esp_err_t i2c_dev_read(const i2c_dev_t *dev, const void *out_data,
+        size_t out_size, void *in_data, size_t in_size)
+{
+    if (!dev || !in_data || !in_size)
+        return ESP_ERR_INVALID_ARG;
+
+    states[dev->port].setup = true;
+
+    return transfer(dev->port, dev->addr, NULL, 0, out_data, out_size, in_data, in_size);
+}
+
+esp_err_t i2c_dev_write(const i2c_dev_t *dev, const void *out_reg,
+        size_t out_reg_size, const void *out_data, size_t out_size)
+{
+    if (!dev || !out_data || !out_size)
+        return ESP_ERR_INVALID_ARG;
+
+    states[dev->port].setup = true;
+
+    return transfer(dev->port, dev->addr, out_reg, out_reg_size, out_data, out_size, NULL, 0);
+}
+
+esp_err_t i2c_dev_read_reg(const i2c_dev_t *dev, uint8_t reg,
+        void *in_data, size_t in_size)
+{
+    return i2c_dev_read(dev, &reg, 1, in_data, in_size);
+}
+
+esp_err_t i2c_dev_write_reg(const i2c_dev_t *dev, uint8_t reg,
+        const void *out_data, size_t out_size)
+{
+    return i2c_dev_write(dev, &reg, 1, out_data, out_size);
+}
+
+esp_err_t i2cdev_submit(i2cdev_req_t *req)
+{
+    if (!req)
+        return ESP_ERR_INVALID_ARG;
+    if (req->dev)
+    {
+        req->port = req->dev->port;
+        req->addr = req->dev->addr;
+        req->prio = req->dev->prio;
+        states[req->port].setup = true;
+    }
+    if (req->port >= I2C_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+    if (req->segs && !segs_valid(req->segs, req->seg_count))
+        return ESP_ERR_INVALID_ARG;
+
+    req->done = false;
+    req->task = xTaskGetCurrentTaskHandle();
+    req->submitted = (int64_t)sim_time_us();
+
+    if (!req->dev && !states[req->port].setup)
+        req->res = ESP_ERR_INVALID_STATE;
+    else if (req->segs)
+        req->res = transfer_segs(req->port, req->addr, req->segs, req->seg_count);
+    else
+        req->res = transfer(req->port, req->addr, req->reg, req->reg_size,
+                            req->out, req->out_size, req->in, req->in_size);
+
+    if (req->cb)
+        req->cb(req);
+    req->done = true;
+
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_wait(i2cdev_req_t *req, TickType_t wait)
+{
+    (void)wait;
+
+    if (!req || req->cb)
+        return ESP_ERR_INVALID_ARG;
+
+    return req->done ? req->res : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t i2cdev_port_write(i2c_port_t port, uint8_t addr, i2cdev_prio_t prio,
+        const void *out_reg, size_t out_reg_size, const void *out_data, size_t out_size)
+{
+    (void)prio;
+
+    if (port >= I2C_NUM_MAX || !out_data || !out_size)
+        return ESP_ERR_INVALID_ARG;
+    if (!states[port].setup)
+        return ESP_ERR_INVALID_STATE;
+
+    return transfer(port, addr, out_reg, out_reg_size, out_data, out_size, NULL, 0);
+}
+
+esp_err_t i2c_dev_batch(const i2c_dev_t *dev, const i2cdev_seg_t *segs, size_t count)
+{
+    if (!dev || !segs_valid(segs, count))
+        return ESP_ERR_INVALID_ARG;
+
+    states[dev->port].setup = true;
+
+    return transfer_segs(dev->port, dev->addr, segs, count);
+}
+
+esp_err_t i2cdev_port_batch(i2c_port_t port, uint8_t addr, i2cdev_prio_t prio,
+        const i2cdev_seg_t *segs, size_t count)
+{
+    (void)prio;
+
+    if (port >= I2C_NUM_MAX || !segs_valid(segs, count))
+        return ESP_ERR_INVALID_ARG;
+    if (!states[port].setup)
+        return ESP_ERR_INVALID_STATE;
+
+    return transfer_segs(port, addr, segs, count);
+}
+
+esp_err_t i2cdev_get_cmd_stats(i2c_port_t port, i2cdev_cmd_stats_t *stats, bool clear)
+{
+    (void)clear;
+
+    if (port >= I2C_NUM_MAX || !stats)
+        return ESP_ERR_INVALID_ARG;
+
+    /* No command links on the host */
+    memset(stats, 0, sizeof(i2cdev_cmd_stats_t));
+
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_get_dev_stats(i2c_port_t port, i2cdev_dev_stats_t *stats, int *count, bool clear)
+{
+    int n;
+
+    if (port >= I2C_NUM_MAX || !stats || !count || *count < 0)
+        return ESP_ERR_INVALID_ARG;
+
+    n = states[port].dev_stats_count;
+    if (n > *count)
+        n = *count;
+    memcpy(stats, states[port].dev_stats, n * sizeof(i2cdev_dev_stats_t));
+    *count = n;
+
+    if (clear)
+        states[port].dev_stats_count = 0;
+
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_bench(i2c_port_t port, uint8_t addr, uint32_t stretch_tick,
+        const void *out_data, size_t out_size, void *in_data, size_t in_size,
+        uint32_t count, i2cdev_bench_t *res)
+{
+    uint64_t start, t;
+    uint64_t lat_sum = 0;
+    uint32_t lat;
+    uint32_t i;
+
+    (void)stretch_tick;
+
+    if (port >= I2C_NUM_MAX || !res || !count)
+        return ESP_ERR_INVALID_ARG;
+    if (!states[port].setup)
+        return ESP_ERR_INVALID_STATE;
+
+    memset(res, 0, sizeof(i2cdev_bench_t));
+    res->lat_min_us = UINT32_MAX;
+
+    start = sim_time_us();
+    for (i = 0; i < count; i++)
+    {
+        t = sim_time_us();
+        if (sim_bus_transfer(addr, out_data, out_data ? out_size : 0,
+                             in_data, in_data ? in_size : 0) != ESP_OK)
+        {
+            res->errors++;
+            continue;
+        }
+        lat = (uint32_t)(sim_time_us() - t);
+
+        res->transactions++;
+        res->bytes += (out_data ? out_size : 0) + (in_data ? in_size : 0);
+        lat_sum += lat;
+        if (lat < res->lat_min_us)
+            res->lat_min_us = lat;
+        if (lat > res->lat_max_us)
+            res->lat_max_us = lat;
+    }
+    res->elapsed_us = (uint32_t)(sim_time_us() - start);
+
+    if (res->transactions)
+        res->lat_avg_us = (uint32_t)(lat_sum / res->transactions);
+    else
+        res->lat_min_us = 0;
+
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_reset_port(i2c_port_t port)
+{
+    if (port >= I2C_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    return ESP_OK;
+}
+
+/* The models never hold SDA, a recovery always succeeds */
+esp_err_t i2cdev_recover_bus(i2c_port_t port)
+{
+    if (port >= I2C_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    states[port].bus_stats.recoveries++;
+    states[port].bus_stats.stuck = false;
+
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_get_bus_stats(i2c_port_t port, i2cdev_bus_stats_t *stats)
+{
+    if (port >= I2C_NUM_MAX || !stats)
+        return ESP_ERR_INVALID_ARG;
+
+    *stats = states[port].bus_stats;
+
+    return ESP_OK;
+}
@@ -0,0 +1,16 @@
+/*
+ * Host shim of the newlib _ansi.h used by the ssd1306 headers
+ */
+
+#ifndef __SIM_ANSI_H__
+#define __SIM_ANSI_H__
+
+#ifdef __cplusplus
+#define _BEGIN_STD_C extern "C" {
+#define _END_STD_C   }
+#else
+#define _BEGIN_STD_C
+#define _END_STD_C
+#endif
+
+#endif /* __SIM_ANSI_H__ */
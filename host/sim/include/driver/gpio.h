@@ -0,0 +1,10 @@
+/*
+ * Host shim of the SDK driver/gpio.h, pin numbers only
+ */
+
+#ifndef __SIM_DRIVER_GPIO_H__
+#define __SIM_DRIVER_GPIO_H__
+
+typedef int gpio_num_t;
+
+#endif /* __SIM_DRIVER_GPIO_H__ */
@@ -0,0 +1,34 @@
+/*
+ * Host shim of the ESP8266 driver/i2c.h, the types used by i2cdev.h. The
+ * transfers themselves go to the device models, see sim_bus.h.
+ */
+
+#ifndef __SIM_DRIVER_I2C_H__
+#define __SIM_DRIVER_I2C_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+typedef enum {
+    I2C_NUM_0 = 0,
+    I2C_NUM_MAX
+} i2c_port_t;
+
+typedef enum {
+    I2C_MODE_MASTER,
+    I2C_MODE_MAX,
+} i2c_mode_t;
+
+typedef struct {
+    i2c_mode_t mode;
+    gpio_num_t sda_io_num;
+    uint32_t sda_pullup_en;
+    gpio_num_t scl_io_num;
+    uint32_t scl_pullup_en;
+    uint32_t clk_stretch_tick;
+} i2c_config_t;
+
+#endif /* __SIM_DRIVER_I2C_H__ */
@@ -0,0 +1,26 @@
+/*
+ * Host shim of the SDK esp_err.h for the simulated I2C backend, see
+ * host/i2c_sim.c. Same codes as the SDK.
+ */
+
+#ifndef __SIM_ESP_ERR_H__
+#define __SIM_ESP_ERR_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef int32_t esp_err_t;
+
+#define ESP_OK                         0
+#define ESP_FAIL                       -1
+
+#define ESP_ERR_NO_MEM                 0x101
+#define ESP_ERR_INVALID_ARG            0x102
+#define ESP_ERR_INVALID_STATE          0x103
+#define ESP_ERR_INVALID_SIZE           0x104
+#define ESP_ERR_NOT_FOUND              0x105
+#define ESP_ERR_NOT_SUPPORTED          0x106
+#define ESP_ERR_TIMEOUT                0x107
+
+#endif /* __SIM_ESP_ERR_H__ */
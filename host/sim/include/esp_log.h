@@ -0,0 +1,17 @@
+/*
+ * Host shim of the SDK esp_log.h, errors and warnings go to stderr, the
+ * other levels are dropped.
+ */
+
+#ifndef __SIM_ESP_LOG_H__
+#define __SIM_ESP_LOG_H__
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E (%s) " fmt "\n", tag, ## __VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W (%s) " fmt "\n", tag, ## __VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGD(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGV(tag, fmt, ...) do { (void)(tag); } while (0)
+
+#endif /* __SIM_ESP_LOG_H__ */
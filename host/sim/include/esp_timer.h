@@ -0,0 +1,16 @@
+/*
+ * Host shim of esp_timer.h, the time is the simulated clock of sim_bus.h
+ */
+
+#ifndef __SIM_ESP_TIMER_H__
+#define __SIM_ESP_TIMER_H__
+
+#include <stdint.h>
+#include "sim_bus.h"
+
+static inline int64_t esp_timer_get_time(void)
+{
+    return (int64_t)sim_time_us();
+}
+
+#endif /* __SIM_ESP_TIMER_H__ */
@@ -0,0 +1,28 @@
+/*
+ * Host shim of FreeRTOS.h. Ticks run on the simulated clock of sim_bus.h,
+ * at the 100 Hz tick rate of the firmware.
+ */
+
+#ifndef __SIM_FREERTOS_H__
+#define __SIM_FREERTOS_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint32_t TickType_t;
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+
+#define pdFALSE                        ((BaseType_t)0)
+#define pdTRUE                         ((BaseType_t)1)
+#define pdPASS                         pdTRUE
+#define pdFAIL                         pdFALSE
+
+#define portMAX_DELAY                  ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ             100
+#define portTICK_PERIOD_MS             ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS               portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(ms)              ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+
+#endif /* __SIM_FREERTOS_H__ */
@@ -0,0 +1,44 @@
+/*
+ * Host shim of semphr.h. The simulation is single threaded, the mutexes
+ * only check that takes and gives are paired.
+ */
+
+#ifndef __SIM_SEMPHR_H__
+#define __SIM_SEMPHR_H__
+
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+
+typedef int *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return calloc(1, sizeof(int));
+}
+
+static inline void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    free(sem);
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait)
+{
+    (void)wait;
+    if (*sem)
+        return pdFALSE;
+    *sem = 1;
+
+    return pdTRUE;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (!*sem)
+        return pdFALSE;
+    *sem = 0;
+
+    return pdTRUE;
+}
+
+#endif /* __SIM_SEMPHR_H__ */
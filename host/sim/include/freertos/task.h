@@ -0,0 +1,50 @@
+/*
+ * Host shim of task.h, delays advance the simulated clock of sim_bus.h
+ */
+
+#ifndef __SIM_TASK_H__
+#define __SIM_TASK_H__
+
+#include "freertos/FreeRTOS.h"
+#include "sim_bus.h"
+
+typedef void *TaskHandle_t;
+
+/* The one simulated task */
+static inline TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return (TaskHandle_t)1;
+}
+
+/* Nothing runs concurrently, a wait would never end */
+static inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+    (void)clear;
+    (void)wait;
+
+    return 0;
+}
+
+static inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    (void)task;
+
+    return pdPASS;
+}
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    sim_time_advance((uint64_t)ticks * 1000000 / configTICK_RATE_HZ);
+}
+
+static inline TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(sim_time_us() * configTICK_RATE_HZ / 1000000);
+}
+
+static inline uint32_t xPortGetTickRateHz(void)
+{
+    return configTICK_RATE_HZ;
+}
+
+#endif /* __SIM_TASK_H__ */
@@ -0,0 +1,316 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "sim_ads1115.h"
+
+#define REG_CONVERSION                 0
+#define REG_CONFIG                     1
+#define REG_THRESH_L                   2
+#define REG_THRESH_H                   3
+
+#define CFG_OS                         (1 << 15)
+#define CFG_MUX(c)                     (((c) >> 12) & 0x07)
+#define CFG_PGA(c)                     (((c) >> 9) & 0x07)
+#define CFG_SINGLE                     (1 << 8)
+#define CFG_DR(c)                      (((c) >> 5) & 0x07)
+#define CFG_WINDOW                     (1 << 4)
+#define CFG_POL_HIGH                   (1 << 3)
+#define CFG_LATCH                      (1 << 2)
+#define CFG_QUE(c)                     ((c) & 0x03)
+#define CFG_QUE_DISABLED               3
+
+#define CONFIG_RESET                   0x8583
+
+/* ALERT/RDY pulse width in conversion ready mode */
+#define RDY_PULSE_US                   8
+
+static const double fs[8] = { 6.144, 4.096, 2.048, 1.024, 0.512, 0.256, 0.256, 0.256 };
+static const uint16_t sps[8] = { 8, 16, 32, 64, 128, 250, 475, 860 };
+
+/* Positive and negative input of every mux setting, -1 is GND */
+static const int8_t mux_in[8][2] = {
+    { 0, 1 }, { 0, 3 }, { 1, 3 }, { 2, 3 },
+    { 0, -1 }, { 1, -1 }, { 2, -1 }, { 3, -1 },
+};
+
+static uint64_t period(const sim_ads1115_t *m, uint16_t config)
+{
+    return (uint64_t)(1e6 / sps[CFG_DR(config)] * m->rate_scale + 0.5);
+}
+
+static bool rdy_mode(const sim_ads1115_t *m)
+{
+    return (m->thresh_hi & 0x8000) && !(m->thresh_lo & 0x8000);
+}
+
+/* Deterministic noise, runs are reproducible */
+static double noise(sim_ads1115_t *m)
+{
+    m->seed = m->seed * 1103515245 + 12345;
+
+    return ((m->seed >> 8) & 0xffff) / 32767.5 - 1.0;
+}
+
+double sim_ads1115_ain(sim_ads1115_t *m, int ain, uint64_t t_us)
+{
+    const sim_wave_t *w = &m->ain[ain];
+    double v = w->dc;
+
+    if (w->amp != 0.0)
+        v += w->amp * sin(2 * M_PI * w->freq_hz * t_us / 1e6);
+    if (w->noise != 0.0)
+        v += w->noise * noise(m);
+
+    return v;
+}
+
+/* Sampled in the middle of the conversion, the modulator averages over it */
+static int16_t convert(sim_ads1115_t *m, uint16_t config, uint64_t t_us)
+{
+    const int8_t *in = mux_in[CFG_MUX(config)];
+    double v, raw;
+
+    v = sim_ads1115_ain(m, in[0], t_us);
+    if (in[1] >= 0)
+        v -= sim_ads1115_ain(m, in[1], t_us);
+
+    raw = floor(v * 32768.0 / fs[CFG_PGA(config)] + 0.5);
+    if (raw > 32767)
+        raw = 32767;
+    if (raw < -32768)
+        raw = -32768;
+
+    return (int16_t)raw;
+}
+
+static void comparator(sim_ads1115_t *m, uint16_t config)
+{
+    static const uint8_t que_len[3] = { 1, 2, 4 };
+    bool over;
+
+    if (CFG_QUE(config) == CFG_QUE_DISABLED)
+    {
+        m->alert = false;
+        m->alert_count = 0;
+        return;
+    }
+
+    if (rdy_mode(m))
+    {
+        m->rdy_pulses++;
+        m->last_rdy_us = m->conv_end;
+        return;
+    }
+
+    if (config & CFG_WINDOW)
+        over = m->conv > m->thresh_hi || m->conv < m->thresh_lo;
+    else
+        over = m->conv > m->thresh_hi;
+
+    if (over)
+    {
+        if (m->alert_count < que_len[CFG_QUE(config)])
+            m->alert_count++;
+        if (m->alert_count >= que_len[CFG_QUE(config)])
+            m->alert = true;
+        return;
+    }
+    m->alert_count = 0;
+
+    /* Traditional mode releases below Lo_thresh, window mode inside the window */
+    if (!(config & CFG_LATCH) && ((config & CFG_WINDOW) || m->conv < m->thresh_lo))
+        m->alert = false;
+}
+
+void sim_ads1115_update(sim_ads1115_t *m)
+{
+    uint64_t now = sim_time_us();
+
+    while (m->converting && now >= m->conv_end)
+    {
+        m->conv = convert(m, m->active, (m->conv_start + m->conv_end) / 2);
+        m->conversions++;
+        comparator(m, m->active);
+
+        if (m->config & CFG_SINGLE)
+        {
+            m->converting = false;
+            break;
+        }
+
+        m->active = m->config;
+        m->conv_start = m->conv_end;
+        m->conv_end += period(m, m->active);
+    }
+}
+
+static void start(sim_ads1115_t *m)
+{
+    m->active = m->config;
+    m->conv_start = sim_time_us();
+    m->conv_end = m->conv_start + period(m, m->active);
+    m->converting = true;
+}
+
+static void write_config(sim_ads1115_t *m, uint16_t val)
+{
+    bool was_continuous = m->converting && !(m->config & CFG_SINGLE);
+
+    m->config = val & ~CFG_OS;
+
+    if (!(val & CFG_SINGLE))
+    {
+        if (!was_continuous)
+            start(m);
+        return;
+    }
+
+    /* Back to single shot, the continuous conversion in flight is dropped */
+    if (was_continuous)
+        m->converting = false;
+
+    if ((val & CFG_OS) && !m->converting)
+        start(m);
+}
+
+static esp_err_t ads_write(sim_dev_t *dev, const uint8_t *data, size_t len)
+{
+    sim_ads1115_t *m = dev->ctx;
+    uint16_t val;
+
+    sim_ads1115_update(m);
+    m->writes++;
+
+    if (data[0] & ~0x03)
+        return ESP_FAIL;
+    m->ptr = data[0];
+    if (len < 3)
+        return ESP_OK;
+
+    val = (data[1] << 8) | data[2];
+    switch (m->ptr) {
+        case REG_CONFIG:
+            write_config(m, val);
+            break;
+        case REG_THRESH_L:
+            m->thresh_lo = (int16_t)val;
+            break;
+        case REG_THRESH_H:
+            m->thresh_hi = (int16_t)val;
+            break;
+        default:
+            /* The conversion register is read only */
+            break;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t ads_read(sim_dev_t *dev, uint8_t *data, size_t len)
+{
+    sim_ads1115_t *m = dev->ctx;
+    uint16_t val;
+    size_t i;
+
+    sim_ads1115_update(m);
+    m->reads++;
+
+    switch (m->ptr) {
+        case REG_CONVERSION:
+            val = (uint16_t)m->conv;
+            /* A latched comparator is released by reading the conversion */
+            if ((m->config & CFG_LATCH) && !rdy_mode(m))
+            {
+                m->alert = false;
+                m->alert_count = 0;
+            }
+            break;
+        case REG_CONFIG:
+            val = m->config | (m->converting ? 0 : CFG_OS);
+            break;
+        case REG_THRESH_L:
+            val = (uint16_t)m->thresh_lo;
+            break;
+        default:
+            val = (uint16_t)m->thresh_hi;
+            break;
+    }
+
+    for (i = 0; i < len; i++)
+        data[i] = i & 1 ? val : val >> 8;
+
+    return ESP_OK;
+}
+
+esp_err_t sim_ads1115_init(sim_ads1115_t *m, uint8_t addr)
+{
+    memset(m, 0, sizeof(sim_ads1115_t));
+
+    m->dev.name = "ads1115";
+    m->dev.addr = addr;
+    m->dev.write = ads_write;
+    m->dev.read = ads_read;
+    m->dev.ctx = m;
+
+    m->rate_scale = 1.0;
+    m->config = CONFIG_RESET & ~CFG_OS;
+    m->thresh_lo = (int16_t)0x8000;
+    m->thresh_hi = 0x7fff;
+    m->seed = addr;
+
+    return sim_bus_attach(&m->dev);
+}
+
+void sim_ads1115_set_wave(sim_ads1115_t *m, int ain, const sim_wave_t *wave)
+{
+    if (ain >= 0 && ain < 4)
+        m->ain[ain] = *wave;
+}
+
+bool sim_ads1115_alert_pin(sim_ads1115_t *m)
+{
+    bool active;
+
+    sim_ads1115_update(m);
+
+    if (CFG_QUE(m->config) == CFG_QUE_DISABLED)
+        return true;
+
+    if (rdy_mode(m))
+        active = m->rdy_pulses && sim_time_us() < m->last_rdy_us + RDY_PULSE_US;
+    else
+        active = m->alert;
+
+    return m->config & CFG_POL_HIGH ? active : !active;
+}
+
+uint64_t sim_ads1115_next_rdy(sim_ads1115_t *m)
+{
+    sim_ads1115_update(m);
+
+    return m->converting ? m->conv_end : 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __SIM_ADS1115_H__
+#define __SIM_ADS1115_H__
+
+/*
+ * ADS1115 register model for the simulated I2C bus. Conversions follow the
+ * data rate on the simulated clock, in single shot and continuous mode, and
+ * sample a waveform per input. A config write in continuous mode applies
+ * from the next conversion, the one in flight finishes with the old mux and
+ * gain, which is what the adc.c pipeline relies on. The ALERT/RDY pin
+ * follows the comparator or pulses on every conversion in conversion ready
+ * mode (Hi_thresh MSB set, Lo_thresh MSB clear).
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sim_bus.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Input voltage dc + amp * sin(2 pi freq t) + uniform noise in +-noise, V */
+typedef struct {
+    double dc;
+    double amp;
+    double freq_hz;
+    double noise;
+} sim_wave_t;
+
+typedef struct {
+    sim_dev_t dev;
+    sim_wave_t ain[4];
+    double rate_scale;                 /* Conversion time factor, the oscillator is +-10% */
+
+    uint8_t ptr;                       /* Register pointer */
+    uint16_t config;
+    uint16_t active;                   /* Config of the conversion in flight */
+    int16_t conv;
+    int16_t thresh_lo;
+    int16_t thresh_hi;
+
+    bool converting;
+    uint64_t conv_start;
+    uint64_t conv_end;
+
+    bool alert;                        /* Comparator asserted, before polarity */
+    uint8_t alert_count;
+    uint32_t seed;
+
+    uint32_t conversions;
+    uint32_t rdy_pulses;
+    uint64_t last_rdy_us;
+    uint32_t reads;                    /* Register reads and writes */
+    uint32_t writes;
+} sim_ads1115_t;
+
+/* Power on state, attached to the bus at addr */
+esp_err_t sim_ads1115_init(sim_ads1115_t *m, uint8_t addr);
+
+void sim_ads1115_set_wave(sim_ads1115_t *m, int ain, const sim_wave_t *wave);
+
+/* Input voltage at time t_us */
+double sim_ads1115_ain(sim_ads1115_t *m, int ain, uint64_t t_us);
+
+/* Run the conversions due at the current simulated time */
+void sim_ads1115_update(sim_ads1115_t *m);
+
+/* ALERT/RDY pin level at the current simulated time, true is high */
+bool sim_ads1115_alert_pin(sim_ads1115_t *m);
+
+/* Time of the next conversion end, 0 when not converting */
+uint64_t sim_ads1115_next_rdy(sim_ads1115_t *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIM_ADS1115_H__ */
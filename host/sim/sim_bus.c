@@ -0,0 +1,162 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "sim_bus.h"
+
+/* Start, address byte with its ACK, stop */
+#define BUS_ADDR_BITS                  11
+#define BUS_BYTE_BITS                  9
+
+static sim_dev_t *devs[SIM_BUS_DEVS_MAX];
+static sim_bus_stats_t dev_stats[SIM_BUS_DEVS_MAX];
+static sim_bus_stats_t total;
+static uint32_t bus_hz = SIM_BUS_HZ;
+static uint64_t now_us;
+
+static int find(uint8_t addr)
+{
+    int i;
+
+    for (i = 0; i < SIM_BUS_DEVS_MAX; i++)
+        if (devs[i] && devs[i]->addr == addr)
+            return i;
+
+    return -1;
+}
+
+esp_err_t sim_bus_attach(sim_dev_t *dev)
+{
+    int i;
+
+    if (find(dev->addr) >= 0)
+        return ESP_ERR_INVALID_STATE;
+
+    for (i = 0; i < SIM_BUS_DEVS_MAX; i++)
+        if (!devs[i])
+        {
+            devs[i] = dev;
+            memset(&dev_stats[i], 0, sizeof(sim_bus_stats_t));
+            return ESP_OK;
+        }
+
+    return ESP_ERR_NO_MEM;
+}
+
+void sim_bus_detach(uint8_t addr)
+{
+    int i = find(addr);
+
+    if (i >= 0)
+        devs[i] = NULL;
+}
+
+void sim_bus_set_hz(uint32_t hz)
+{
+    bus_hz = hz ? hz : SIM_BUS_HZ;
+}
+
+static void account(sim_bus_stats_t *s, bool nack, size_t out_size,
+                    size_t in_size, uint32_t us)
+{
+    s->transactions++;
+    if (nack)
+        s->nacks++;
+    else
+    {
+        s->bytes_out += out_size;
+        s->bytes_in += in_size;
+    }
+    s->bus_us += us;
+}
+
+esp_err_t sim_bus_transfer(uint8_t addr, const void *out, size_t out_size,
+                           void *in, size_t in_size)
+{
+    esp_err_t res = ESP_FAIL;
+    uint64_t bits;
+    uint32_t us;
+    int i = find(addr);
+
+    /* A read after a write needs a second address byte */
+    bits = BUS_ADDR_BITS + (out_size + in_size) * BUS_BYTE_BITS;
+    if (out_size && in_size)
+        bits += BUS_ADDR_BITS - 1;
+
+    if (i >= 0)
+    {
+        res = ESP_OK;
+        if (out_size)
+            res = devs[i]->write ? devs[i]->write(devs[i], out, out_size) : ESP_FAIL;
+        if (res == ESP_OK && in_size)
+            res = devs[i]->read ? devs[i]->read(devs[i], in, in_size) : ESP_FAIL;
+    }
+
+    /* A NACK ends the transaction after the address */
+    if (res != ESP_OK)
+        bits = BUS_ADDR_BITS;
+
+    us = (uint32_t)((bits * 1000000 + bus_hz - 1) / bus_hz);
+    now_us += us;
+
+    account(&total, res != ESP_OK, out_size, in_size, us);
+    if (i >= 0)
+        account(&dev_stats[i], res != ESP_OK, out_size, in_size, us);
+
+    return res;
+}
+
+void sim_bus_get_stats(uint8_t addr, sim_bus_stats_t *stats)
+{
+    int i;
+
+    if (!addr)
+    {
+        *stats = total;
+        return;
+    }
+
+    i = find(addr);
+    if (i >= 0)
+        *stats = dev_stats[i];
+    else
+        memset(stats, 0, sizeof(sim_bus_stats_t));
+}
+
+void sim_bus_clear_stats(void)
+{
+    memset(dev_stats, 0, sizeof(dev_stats));
+    memset(&total, 0, sizeof(total));
+}
+
+uint64_t sim_time_us(void)
+{
+    return now_us;
+}
+
+void sim_time_advance(uint64_t us)
+{
+    now_us += us;
+}
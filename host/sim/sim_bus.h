@@ -0,0 +1,99 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __SIM_BUS_H__
+#define __SIM_BUS_H__
+
+/*
+ * Simulated I2C bus for the host build: device models attached by address,
+ * a transaction log and a simulated clock. Transactions take the time the
+ * bits need at the bus rate, vTaskDelay() advances the clock too, so the
+ * models see the timing of the firmware without running in real time.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SIM_BUS_DEVS_MAX               8
+
+/* Default SCL rate, the ESP8266 software driver runs at about 100 kHz */
+#define SIM_BUS_HZ                     100000
+
+typedef struct sim_dev sim_dev_t;
+
+/*
+ * A device model. write() gets the bytes after the address of a write,
+ * read() fills the bytes of a read. A read issued after a write with a
+ * repeated start comes as two calls. Returning ESP_FAIL is a NACK.
+ */
+struct sim_dev {
+    const char *name;
+    uint8_t addr;                      /* Unshifted address */
+    esp_err_t (*write)(sim_dev_t *dev, const uint8_t *data, size_t len);
+    esp_err_t (*read)(sim_dev_t *dev, uint8_t *data, size_t len);
+    void *ctx;
+};
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t nacks;
+    uint32_t bytes_out;
+    uint32_t bytes_in;
+    uint64_t bus_us;                   /* Time on the bus */
+} sim_bus_stats_t;
+
+esp_err_t sim_bus_attach(sim_dev_t *dev);
+void sim_bus_detach(uint8_t addr);
+
+/* The SCL rate sets the transaction time, 0 restores SIM_BUS_HZ */
+void sim_bus_set_hz(uint32_t hz);
+
+/*
+ * One transaction: out_size bytes written then in_size bytes read after a
+ * repeated start. Either part may be empty. Returns ESP_FAIL when nobody
+ * acknowledges the address.
+ */
+esp_err_t sim_bus_transfer(uint8_t addr, const void *out, size_t out_size,
+                           void *in, size_t in_size);
+
+/* Per address counters, addr 0 gets the bus totals */
+void sim_bus_get_stats(uint8_t addr, sim_bus_stats_t *stats);
+void sim_bus_clear_stats(void);
+
+uint64_t sim_time_us(void);
+void sim_time_advance(uint64_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIM_BUS_H__ */
@@ -0,0 +1,266 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "sim_ssd1306.h"
+
+#define CTRL_CO                        0x80
+#define CTRL_DC                        0x40
+
+/* Argument bytes of the multi byte commands */
+static uint8_t cmd_args(uint8_t c)
+{
+    switch (c) {
+        case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+        case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+            return 1;
+        case 0x21: case 0x22: case 0xA3:
+            return 2;
+        case 0x29: case 0x2A:
+            return 5;
+        case 0x26: case 0x27:
+            return 6;
+        default:
+            return 0;
+    }
+}
+
+static void page_cmd(sim_ssd1306_t *m)
+{
+    uint8_t c = m->cmd[0];
+
+    if (m->mode != SIM_SSD1306_PAGE)
+    {
+        m->ignored++;
+        return;
+    }
+
+    if (c >= 0xB0)
+        m->page = c & 0x07;
+    else if (c >= 0x10)
+        m->page_col = (m->page_col & 0x0F) | ((c & 0x07) << 4);
+    else
+        m->page_col = (m->page_col & 0xF0) | c;
+
+    if (c < 0xB0)
+        m->col = m->page_col;
+}
+
+static void exec(sim_ssd1306_t *m)
+{
+    uint8_t c = m->cmd[0];
+
+    m->commands++;
+
+    if (c <= 0x1F || (c >= 0xB0 && c <= 0xB7))
+    {
+        page_cmd(m);
+        return;
+    }
+    if (c >= 0x40 && c <= 0x7F)
+    {
+        m->start_line = c & 0x3F;
+        return;
+    }
+
+    switch (c) {
+        case 0x20:
+            if ((m->cmd[1] & 0x03) != 3)
+                m->mode = m->cmd[1] & 0x03;
+            break;
+        case 0x21:
+            m->col_start = m->cmd[1] & 0x7F;
+            m->col_end = m->cmd[2] & 0x7F;
+            m->col = m->col_start;
+            break;
+        case 0x22:
+            m->page_start = m->cmd[1] & 0x07;
+            m->page_end = m->cmd[2] & 0x07;
+            m->page = m->page_start;
+            break;
+        case 0x81:
+            m->contrast = m->cmd[1];
+            break;
+        case 0xA0:
+        case 0xA1:
+            m->seg_remap = c & 1;
+            break;
+        case 0xA4:
+        case 0xA5:
+            m->all_on = c & 1;
+            break;
+        case 0xA6:
+        case 0xA7:
+            m->inverse = c & 1;
+            break;
+        case 0xA8:
+            m->mux_ratio = m->cmd[1] & 0x3F;
+            break;
+        case 0xAE:
+        case 0xAF:
+            m->display_on = c & 1;
+            break;
+        case 0xC0:
+        case 0xC8:
+            m->com_remap = c & 0x08;
+            break;
+        case 0xE3:
+            m->nops++;
+            break;
+        case 0x26: case 0x27: case 0x29: case 0x2A: case 0x2E: case 0x2F:
+        case 0x8D: case 0xA3: case 0xD3: case 0xD5: case 0xD9: case 0xDA:
+        case 0xDB:
+            /* Scrolling, timing and analog settings, no effect on the RAM */
+            break;
+        default:
+            m->unknown++;
+            break;
+    }
+}
+
+static void command(sim_ssd1306_t *m, uint8_t b)
+{
+    if (!m->cmd_need)
+    {
+        m->cmd[0] = b;
+        m->cmd_len = 1;
+        m->cmd_need = cmd_args(b);
+    }
+    else
+    {
+        m->cmd[m->cmd_len++] = b;
+        m->cmd_need--;
+    }
+
+    if (!m->cmd_need)
+        exec(m);
+}
+
+static void data(sim_ssd1306_t *m, uint8_t b)
+{
+    m->ram[m->page][m->col] = b;
+    m->data_bytes++;
+
+    switch (m->mode) {
+        case SIM_SSD1306_HORIZONTAL:
+            if (m->col++ < m->col_end)
+                break;
+            m->col = m->col_start;
+            if (m->page++ >= m->page_end)
+                m->page = m->page_start;
+            break;
+
+        case SIM_SSD1306_VERTICAL:
+            if (m->page++ < m->page_end)
+                break;
+            m->page = m->page_start;
+            if (m->col++ >= m->col_end)
+                m->col = m->col_start;
+            break;
+
+        default:
+            if (++m->col >= SIM_SSD1306_WIDTH)
+                m->col = m->page_col;
+            break;
+    }
+}
+
+/*
+ * Control byte with Co clear: the rest is a command or a data stream. With
+ * Co set only the next byte, then a new control byte.
+ */
+static esp_err_t oled_write(sim_dev_t *dev, const uint8_t *buf, size_t len)
+{
+    sim_ssd1306_t *m = dev->ctx;
+    uint8_t ctrl;
+    size_t i = 0;
+
+    m->transactions++;
+
+    while (i < len)
+    {
+        ctrl = buf[i++];
+        if (ctrl & ~(CTRL_CO | CTRL_DC))
+            return ESP_FAIL;
+
+        do {
+            if (i == len)
+                break;
+            if (ctrl & CTRL_DC)
+                data(m, buf[i++]);
+            else
+                command(m, buf[i++]);
+        } while (!(ctrl & CTRL_CO));
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t sim_ssd1306_init(sim_ssd1306_t *m, uint8_t addr)
+{
+    memset(m, 0, sizeof(sim_ssd1306_t));
+
+    m->dev.name = "ssd1306";
+    m->dev.addr = addr;
+    m->dev.write = oled_write;
+    m->dev.ctx = m;
+
+    m->mode = SIM_SSD1306_PAGE;
+    m->col_end = SIM_SSD1306_WIDTH - 1;
+    m->page_end = SIM_SSD1306_PAGES - 1;
+    m->contrast = 0x7F;
+    m->mux_ratio = 63;
+
+    return sim_bus_attach(&m->dev);
+}
+
+bool sim_ssd1306_pixel(const sim_ssd1306_t *m, int x, int y)
+{
+    return (m->ram[y / 8][x] >> (y % 8)) & 1;
+}
+
+void sim_ssd1306_dump(const sim_ssd1306_t *m, FILE *f)
+{
+    static const char cell[4] = { ' ', '"', ',', '#' };
+    int x, y;
+
+    fprintf(f, "+");
+    for (x = 0; x < SIM_SSD1306_WIDTH; x++)
+        fputc('-', f);
+    fprintf(f, "+\n");
+
+    for (y = 0; y < SIM_SSD1306_PAGES * 8; y += 2)
+    {
+        fputc('|', f);
+        for (x = 0; x < SIM_SSD1306_WIDTH; x++)
+            fputc(cell[sim_ssd1306_pixel(m, x, y) | sim_ssd1306_pixel(m, x, y + 1) << 1], f);
+        fprintf(f, "|\n");
+    }
+
+    fprintf(f, "+");
+    for (x = 0; x < SIM_SSD1306_WIDTH; x++)
+        fputc('-', f);
+    fprintf(f, "+\n");
+}
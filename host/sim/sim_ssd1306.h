@@ -0,0 +1,103 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __SIM_SSD1306_H__
+#define __SIM_SSD1306_H__
+
+/*
+ * SSD1306 model for the simulated I2C bus. Decodes the control bytes and
+ * the command stream, multi byte commands may span transactions like on
+ * the chip, and writes the data bytes into the display RAM following the
+ * addressing mode. Page mode commands (0xB0-0xB7, 0x00-0x1F) only apply in
+ * page addressing mode, as in the datasheet.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sim_bus.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SIM_SSD1306_WIDTH              128
+#define SIM_SSD1306_PAGES              8
+
+typedef enum {
+    SIM_SSD1306_HORIZONTAL = 0,
+    SIM_SSD1306_VERTICAL,
+    SIM_SSD1306_PAGE,
+} sim_ssd1306_mode_t;
+
+typedef struct {
+    sim_dev_t dev;
+    uint8_t ram[SIM_SSD1306_PAGES][SIM_SSD1306_WIDTH];
+
+    sim_ssd1306_mode_t mode;
+    uint8_t col;
+    uint8_t page;
+    uint8_t col_start;
+    uint8_t col_end;
+    uint8_t page_start;
+    uint8_t page_end;
+    uint8_t page_col;                  /* Page mode column start */
+
+    bool display_on;
+    bool inverse;
+    bool all_on;
+    bool seg_remap;
+    bool com_remap;
+    uint8_t contrast;
+    uint8_t start_line;
+    uint8_t mux_ratio;
+
+    uint8_t cmd[8];                    /* Command being decoded */
+    uint8_t cmd_len;
+    uint8_t cmd_need;
+
+    uint32_t commands;
+    uint32_t nops;
+    uint32_t ignored;                  /* Page mode commands outside page mode */
+    uint32_t unknown;
+    uint32_t data_bytes;
+    uint32_t transactions;
+} sim_ssd1306_t;
+
+/* Reset state, attached to the bus at addr */
+esp_err_t sim_ssd1306_init(sim_ssd1306_t *m, uint8_t addr);
+
+/* Display RAM bit of pixel x, y, same layout as the driver buffer */
+bool sim_ssd1306_pixel(const sim_ssd1306_t *m, int x, int y);
+
+/* Two pixel rows per text line, '#' both set, '"' top, ',' bottom */
+void sim_ssd1306_dump(const sim_ssd1306_t *m, FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIM_SSD1306_H__ */
@@ -0,0 +1,1206 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+#include "driver/gpio.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "nvs_utils.h"
+#include "adc.h"
+
+#define ADC_DATA_RATE                  ADS111X_DATA_RATE_64
+
+/*
+ * The primary device runs in continuous mode with ALERT/RDY connected.
+ * Secondary devices convert in single shot mode at twice the data rate, a
+ * conversion started on a ready pulse of the primary device is done by the
+ * next one even with the +-10% oscillator tolerance between devices.
+ */
+#define ADC_DEV_PRIMARY                0
+#define ADC_AUX_DATA_RATE              ADS111X_DATA_RATE_128
+
+/* ADC task settings, above the main task so sampling is never delayed */
+#define ADC_TASK_PRIORITY              11
+#define ADC_TASK_STACK_SIZE            2048
+
+/* Samples not yet consumed by the main task */
+#define ADC_QUEUE_LEN                  32
+
+/*
+ * Conversion ready mode: MSB of the high threshold set, MSB of the low
+ * threshold cleared and the comparator queue enabled. In continuous mode
+ * ALERT/RDY then pulses low for ~8us at the end of every conversion.
+ */
+#define ADC_RDY_HIGH_THRESH            ((int16_t)0x8000)
+#define ADC_RDY_LOW_THRESH             ((int16_t)0x0000)
+
+/*
+ * Power fail trip: window comparator with the high threshold at full scale,
+ * so ALERT/RDY asserts as soon as a conversion falls below the low threshold.
+ * The low threshold MSB is always 0 and is left programmed in conversion
+ * ready mode, only the high threshold and the comparator mode are switched.
+ */
+#define ADC_TRIP_HIGH_THRESH           ((int16_t)ADS111X_MAX_VALUE)
+
+/* ADS111x register pointer of the conversion register */
+#define ADC_REG_CONVERSION             0x00
+
+/* Scheduler result when the engine should park on the trip channel */
+#define ADC_PARK                       (-1)
+
+/* Scheduler result for a device without channels */
+#define ADC_NONE                       (-2)
+
+/*
+ * Self healing, in consecutive failed slots. A stuck bus is left to i2cdev,
+ * which clocks it out and reinstalls the driver after
+ * CONFIG_I2CDEV_STUCK_TIMEOUTS timeouts. The devices are programmed again
+ * right after such a recovery, and every ADC_FAIL_SETUP failed slots
+ * otherwise since a brown-out may have reset them. Past the first attempt
+ * the scan waits ADC_FAIL_BACKOFF_MS after the failed slots in between.
+ */
+#define ADC_FAIL_SETUP                 3
+#define ADC_FAIL_BACKOFF_MS            500
+
+/*
+ * Calibrated conversion is (raw * mul) >> shift with rounding. The multiplier
+ * is kept below 2^15 so the product plus the rounding bit fits in 31 bits.
+ */
+#define ADC_CAL_MUL_MAX                (1 << 15)
+#define ADC_CAL_SHIFT_MAX              30
+#define ADC_CAL_FULL_SCALE_MAX         1000000
+
+/* Min distance between the two calibration points, in raw counts */
+#define ADC_CAL_MIN_SPAN               (ADS111X_MAX_VALUE / 16)
+
+/*
+ * Auto gain ranging, every PGA step doubles the gain. One step down above
+ * ADC_RANGE_DOWN, one step up below ADC_RANGE_UP so the reading lands at
+ * most at 3/4 of full scale, below ADC_RANGE_DOWN. The gap is the hysteresis.
+ */
+#define ADC_GAIN_STEP_MAX              (ADS111X_GAIN_0V256 - ADC_GAIN)
+#define ADC_RANGE_DOWN                 (ADS111X_MAX_VALUE / 8 * 7)
+#define ADC_RANGE_UP                   (ADS111X_MAX_VALUE / 8 * 3)
+
+/*
+ * Calibration sums are normalized to the highest gain resolution, so points
+ * taken at different gains can be combined.
+ */
+#define ADC_CAL_SCALE                  (ADC_CAL_SAMPLES << ADC_GAIN_STEP_MAX)
+
+/* Max time to wait for a calibration point on top of the channel rate */
+#define ADC_CAL_TIMEOUT_MS             1000
+
+static const char *TAG = "ADC";
+
+/* Samples per second for each ads111x_data_rate_t */
+static const int adc_sps[] = {8, 16, 32, 64, 128, 250, 475, 860};
+
+static i2c_dev_t adc_devs[ADC_DEV_MAX];
+static int adc_dev_count;
+static SemaphoreHandle_t adc_rdy_sem = NULL;
+static TickType_t adc_rdy_timeout;
+static int adc_period_ms;
+static QueueHandle_t adc_queue = NULL;
+static adc_stats_t adc_stats;
+
+/* Scan scheduler state */
+static const adc_chan_cfg_t *adc_chans;
+static int adc_chan_count;
+static uint32_t adc_chan_due[ADC_CHAN_MAX];
+static uint32_t adc_slot;
+static filter_t adc_filters[ADC_CHAN_MAX];
+
+/* Power fail trip state */
+static int adc_trip_chan = -1;
+static int adc_trip_voltage;
+static int16_t adc_trip_raw = ADC_RDY_LOW_THRESH;
+static bool adc_trip_armed;
+static int adc_last_chan = -1;
+
+/* Consecutive failed slots */
+static uint32_t adc_fail_count;
+
+/* i2cdev bus recoveries already seen by adc_heal() */
+static uint32_t adc_bus_recoveries;
+
+typedef enum {
+    ADC_FAULT_NACK,
+    ADC_FAULT_I2C_TIMEOUT,
+    ADC_FAULT_RDY_TIMEOUT,
+    ADC_FAULT_RANGE,
+} adc_fault_t;
+
+typedef struct {
+    adc_cal_t cal;
+    int32_t mul;
+    uint8_t shift;
+} adc_scale_t;
+
+/* Calibration used by the scan task */
+static adc_scale_t adc_scale[ADC_CHAN_MAX];
+
+/* New calibrations waiting to be picked up by the scan task */
+static adc_scale_t adc_scale_new[ADC_CHAN_MAX];
+static uint32_t adc_scale_pending;
+
+/* Conversion running on every secondary device */
+static int adc_aux_chan[ADC_DEV_MAX];
+/* Conversion register reads in flight, one per device */
+static ads111x_read_t adc_reads[ADC_DEV_MAX];
+static bool adc_aux_reading[ADC_DEV_MAX];
+static ads111x_gain_t adc_aux_gain[ADC_DEV_MAX];
+
+/* Auto gain ranging state */
+static ads111x_gain_t adc_chan_gain[ADC_CHAN_MAX];
+static ads111x_gain_t adc_chan_gain_max[ADC_CHAN_MAX];
+
+/* Calibration point capture, adc_cal_sum is valid once the count is reached */
+static volatile int adc_cal_chan = -1;
+static volatile int adc_cal_count;
+static int32_t adc_cal_sum;
+
+/* First calibration point of every channel, normalized raw sum */
+static int32_t adc_cal_ref_sum[ADC_CHAN_MAX];
+static int adc_cal_ref_mv[ADC_CHAN_MAX];
+static uint32_t adc_cal_ref_valid;
+
+static void adc_rdy_isr_handler(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+
+    xSemaphoreGiveFromISR(adc_rdy_sem, &woken);
+    if (woken == pdTRUE)
+        portYIELD_FROM_ISR();
+}
+
+static void adc_fault(adc_fault_t fault)
+{
+    switch (fault) {
+        case ADC_FAULT_NACK:
+            adc_stats.nack++;
+            break;
+
+        case ADC_FAULT_I2C_TIMEOUT:
+            adc_stats.i2c_timeout++;
+            break;
+
+        case ADC_FAULT_RDY_TIMEOUT:
+            adc_stats.rdy_timeout++;
+            break;
+
+        case ADC_FAULT_RANGE:
+            adc_stats.out_of_range++;
+            break;
+    }
+    adc_stats.errors++;
+}
+
+/* Classify a failed I2C access, the driver reports a NACK as ESP_FAIL */
+static esp_err_t adc_check(esp_err_t err)
+{
+    if (err != ESP_OK)
+        adc_fault(err == ESP_ERR_TIMEOUT ? ADC_FAULT_I2C_TIMEOUT : ADC_FAULT_NACK);
+
+    return err;
+}
+
+/* Wait for the end of the ongoing conversion */
+static esp_err_t adc_wait_rdy(void)
+{
+    if (xSemaphoreTake(adc_rdy_sem, adc_rdy_timeout) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "ADC conversion ready timeout!");
+        adc_fault(ADC_FAULT_RDY_TIMEOUT);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    return ESP_OK;
+}
+
+static bool adc_cal_valid(const adc_cal_t *cal)
+{
+    return cal->full_scale > 0 && cal->full_scale <= ADC_CAL_FULL_SCALE_MAX;
+}
+
+/*
+ * Precompute the multiplier for the largest shift keeping it below
+ * ADC_CAL_MUL_MAX, there is no hardware divider to spend per sample.
+ */
+static void adc_scale_init(adc_scale_t *scale, const adc_cal_t *cal)
+{
+    uint8_t shift = 0;
+
+    while (shift < ADC_CAL_SHIFT_MAX &&
+           ((((int64_t)cal->full_scale << (shift + 1)) + ADS111X_MAX_VALUE / 2) /
+            ADS111X_MAX_VALUE) < ADC_CAL_MUL_MAX)
+        shift++;
+
+    scale->cal = *cal;
+    scale->shift = shift;
+    scale->mul = (((int64_t)cal->full_scale << shift) + ADS111X_MAX_VALUE / 2) /
+                 ADS111X_MAX_VALUE;
+}
+
+/* Every PGA step above ADC_GAIN is one more bit of shift */
+static inline int adc_raw_to_mv(int chan, int16_t raw, ads111x_gain_t gain)
+{
+    const adc_scale_t *scale = &adc_scale[chan];
+    uint8_t shift = scale->shift + (gain - ADC_GAIN);
+    int32_t mv = (int32_t)raw * scale->mul;
+
+    if (shift)
+        mv = (mv + (1 << (shift - 1))) >> shift;
+
+    return mv + scale->cal.offset;
+}
+
+static int16_t adc_mv_to_raw(int chan, int voltage)
+{
+    const adc_cal_t *cal = &adc_scale[chan].cal;
+    int64_t raw = ((int64_t)(voltage - cal->offset) * ADS111X_MAX_VALUE) /
+                  cal->full_scale;
+
+    if (raw < 0)
+        return 0;
+    if (raw > ADS111X_MAX_VALUE)
+        return ADS111X_MAX_VALUE;
+
+    return raw;
+}
+
+static void adc_cal_key(int chan, char *key, size_t len)
+{
+    snprintf(key, len, NVS_ADC_CAL "%d", chan);
+}
+
+/* Saved calibration of chan, the table full scale if there is none */
+static void adc_cal_load(int chan)
+{
+    adc_cal_t cal = {adc_chans[chan].full_scale, 0};
+    adc_cal_t saved;
+    size_t len = sizeof(saved);
+    char key[16];
+
+    adc_cal_key(chan, key, sizeof(key));
+    if (nvs_get_handle() &&
+        nvs_get_blob(nvs_get_handle(), key, &saved, &len) == ESP_OK &&
+        len == sizeof(saved) && adc_cal_valid(&saved))
+    {
+        ESP_LOGI(TAG, "ADC chan %d calibrated: full scale %d mV, offset %d mV",
+                 chan, (int)saved.full_scale, (int)saved.offset);
+        cal = saved;
+    }
+
+    adc_scale_init(&adc_scale[chan], &cal);
+}
+
+/* Hand a new calibration over to the scan task */
+static void adc_cal_set(int chan, const adc_cal_t *cal)
+{
+    adc_scale_t scale;
+
+    adc_scale_init(&scale, cal);
+
+    taskENTER_CRITICAL();
+    adc_scale_new[chan] = scale;
+    adc_scale_pending |= 1 << chan;
+    taskEXIT_CRITICAL();
+}
+
+/* Mux and PGA gain in a single config write, start a single shot if asked */
+static esp_err_t adc_set_input(int chan, ads111x_gain_t gain, bool start)
+{
+    if (adc_check(ads111x_set_input(&adc_devs[adc_chans[chan].dev],
+                                    adc_chans[chan].mux, gain, start)) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "ADC failed to set input on dev %d chan %d!",
+                 adc_chans[chan].dev, adc_chans[chan].mux);
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+/*
+ * Program every device, at init and again when they may have been reset by a
+ * brown-out. The low threshold is the power fail trip one once adc_start()
+ * was called, its MSB is cleared either way.
+ */
+static esp_err_t adc_setup(void)
+{
+    i2c_dev_t *dev = &adc_devs[ADC_DEV_PRIMARY];
+    int i;
+
+    if (ads111x_set_data_rate(dev, ADC_DATA_RATE) != ESP_OK ||
+        ads111x_set_gain(dev, ADC_GAIN) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "ADC set data rate failed!");
+        return ESP_FAIL;
+    }
+
+    /* ALERT/RDY as conversion ready output, active low */
+    if (ads111x_set_comp_high_thresh(dev, ADC_RDY_HIGH_THRESH) != ESP_OK        ||
+        ads111x_set_comp_low_thresh(dev, adc_trip_raw) != ESP_OK               ||
+        ads111x_set_comp_mode(dev, ADS111X_COMP_MODE_NORMAL) != ESP_OK         ||
+        ads111x_set_comp_polarity(dev, ADS111X_COMP_POLARITY_LOW) != ESP_OK    ||
+        ads111x_set_comp_latch(dev, ADS111X_COMP_LATCH_DISABLED) != ESP_OK     ||
+        ads111x_set_comp_queue(dev, ADS111X_COMP_QUEUE_1) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "ADC set conversion ready mode failed!");
+        return ESP_FAIL;
+    }
+
+    for (i = ADC_DEV_PRIMARY + 1; i < adc_dev_count; i++)
+    {
+        dev = &adc_devs[i];
+        if (ads111x_set_data_rate(dev, ADC_AUX_DATA_RATE) != ESP_OK ||
+            ads111x_set_gain(dev, ADC_GAIN) != ESP_OK              ||
+            ads111x_set_mode(dev, ADS111X_MODE_SINGLE_SHOT) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "ADC setup failed on dev %d!", i);
+            return ESP_FAIL;
+        }
+        adc_aux_chan[i] = -1;
+    }
+
+    if (ads111x_set_mode(&adc_devs[ADC_DEV_PRIMARY], ADS111X_MODE_CONTINUOUS) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "ADC set mode failed!");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t adc_init(i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio,
+                   gpio_num_t alert_gpio, const uint8_t *addrs, int count)
+{
+    gpio_config_t io_conf;
+    i2cdev_bus_stats_t bus;
+    int i;
+
+    ESP_LOGI(TAG, "ADC init, %d device(s)", count);
+
+    if (!addrs || count <= 0 || count > ADC_DEV_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    adc_rdy_sem = xSemaphoreCreateBinary();
+    if (adc_rdy_sem == NULL)
+    {
+        ESP_LOGE(TAG, "ADC could not create semaphore!");
+        return ESP_FAIL;
+    }
+
+    /* Wait at most two conversion periods for a ready pulse */
+    adc_period_ms = (1000 + adc_sps[ADC_DATA_RATE] - 1) / adc_sps[ADC_DATA_RATE];
+    adc_rdy_timeout = (2 * adc_period_ms) / portTICK_RATE_MS + 2;
+
+    for (i = 0; i < count; i++)
+    {
+        if (ads111x_init_desc(&adc_devs[i], addrs[i], port, sda_gpio, scl_gpio))
+        {
+            ESP_LOGE(TAG, "ADC init failed on dev %d, addr 0x%02x!", i, addrs[i]);
+            return ESP_FAIL;
+        }
+    }
+    adc_dev_count = count;
+
+    /* ALERT/RDY is open drain, pulled up and sampled on the falling edge */
+    io_conf.intr_type = GPIO_INTR_NEGEDGE;
+    io_conf.mode = GPIO_MODE_INPUT;
+    io_conf.pin_bit_mask = (1 << alert_gpio);
+    io_conf.pull_down_en = 0;
+    io_conf.pull_up_en = 1;
+    if (gpio_config(&io_conf) != ESP_OK                                    ||
+        gpio_install_isr_service(0) != ESP_OK                              ||
+        gpio_isr_handler_add(alert_gpio, adc_rdy_isr_handler, NULL) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "ADC alert GPIO init failed!");
+        return ESP_FAIL;
+    }
+
+    if (i2cdev_get_bus_stats(port, &bus) == ESP_OK)
+        adc_bus_recoveries = bus.recoveries;
+
+    return adc_setup();
+}
+
+/*
+ * Pick the channel of dev converted in the current slot: the highest priority
+ * channel that is due. If none is due, park on the trip channel when allowed,
+ * otherwise give the slot to the highest priority channel.
+ */
+static int adc_pick(int dev, bool allow_park)
+{
+    int best = -1;
+    int top = -1;
+    int i;
+
+    for (i = 0; i < adc_chan_count; i++)
+    {
+        if (adc_chans[i].dev != dev)
+            continue;
+
+        if (top < 0 || adc_chans[i].priority > adc_chans[top].priority)
+            top = i;
+
+        if ((int32_t)(adc_slot - adc_chan_due[i]) < 0)
+            continue;
+
+        if (best < 0 ||
+            adc_chans[i].priority > adc_chans[best].priority ||
+            (adc_chans[i].priority == adc_chans[best].priority &&
+             (int32_t)(adc_chan_due[i] - adc_chan_due[best]) < 0))
+            best = i;
+    }
+
+    if (top < 0)
+        return ADC_NONE;
+
+    if (best < 0)
+    {
+        if (allow_park)
+            return ADC_PARK;
+        best = top;
+    }
+
+    adc_chan_due[best] = adc_slot + adc_chans[best].period;
+
+    return best;
+}
+
+/*
+ * Slots are counted on the primary device. While the trip is armed the trip
+ * channel takes every other slot the scan needs, so at most one conversion
+ * of another channel runs between two of it. A power fail is then seen
+ * within two conversion periods while scanning (~31 ms at 64 SPS) and within
+ * one while parked on it with the comparator armed.
+ */
+static int adc_schedule(bool allow_park)
+{
+    int chan;
+
+    if (allow_park && adc_last_chan != adc_trip_chan)
+        chan = adc_trip_chan;
+    else
+        chan = adc_pick(ADC_DEV_PRIMARY, allow_park);
+
+    if (chan != ADC_PARK)
+        adc_slot++;
+
+    adc_last_chan = chan == ADC_PARK ? adc_trip_chan : chan;
+
+    return chan;
+}
+
+/*
+ * Make sure the conversion running after this returns uses chan. In
+ * continuous mode a config write does not affect the ongoing conversion, so
+ * drop any pulse seen before the mux write completed and flush the conversion
+ * started with the old settings. A pulse lost in between only delays the sync
+ * by one period, the mux stays the same.
+ */
+static esp_err_t adc_sync(int chan)
+{
+    if (adc_set_input(chan, adc_chan_gain[chan], false) != ESP_OK)
+        return ESP_FAIL;
+
+    xSemaphoreTake(adc_rdy_sem, 0);
+
+    return adc_wait_rdy();
+}
+
+/* Ticks until the first channel is due, at least one conversion period */
+static TickType_t adc_park_ticks(void)
+{
+    int32_t slots = INT32_MAX;
+    int32_t left;
+    int i;
+
+    for (i = 0; i < adc_chan_count; i++)
+    {
+        left = (int32_t)(adc_chan_due[i] - adc_slot);
+        if (left < slots)
+            slots = left;
+    }
+    if (slots < 1)
+        slots = 1;
+
+    return (slots * adc_period_ms) / portTICK_RATE_MS + 1;
+}
+
+/*
+ * Only the low threshold is used by the trip. Its MSB is cleared, so it can
+ * stay programmed while ALERT/RDY is in conversion ready mode.
+ */
+static esp_err_t adc_trip_set_thresh(void)
+{
+    adc_trip_raw = adc_mv_to_raw(adc_trip_chan, adc_trip_voltage);
+    if (adc_check(ads111x_set_comp_low_thresh(&adc_devs[ADC_DEV_PRIMARY],
+                                              adc_trip_raw)) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "ADC failed to set the power fail threshold!");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "ADC power fail trip on chan %d below %d mV (raw %d)",
+             adc_chans[adc_trip_chan].mux, adc_trip_voltage, adc_trip_raw);
+
+    return ESP_OK;
+}
+
+/* Switch to the calibrations set since the last call */
+static esp_err_t adc_cal_apply(void)
+{
+    uint32_t pending;
+    int i;
+
+    taskENTER_CRITICAL();
+    pending = adc_scale_pending;
+    adc_scale_pending = 0;
+    for (i = 0; i < adc_chan_count; i++)
+    {
+        if (pending & (1 << i))
+            adc_scale[i] = adc_scale_new[i];
+    }
+    taskEXIT_CRITICAL();
+
+    if (adc_trip_chan >= 0 && (pending & (1 << adc_trip_chan)) &&
+        adc_trip_set_thresh() != ESP_OK)
+    {
+        /* Retry on the next loop */
+        taskENTER_CRITICAL();
+        if (!(adc_scale_pending & (1 << adc_trip_chan)))
+        {
+            adc_scale_new[adc_trip_chan] = adc_scale[adc_trip_chan];
+            adc_scale_pending |= 1 << adc_trip_chan;
+        }
+        taskEXIT_CRITICAL();
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t adc_trip_arm(bool arm, int16_t *raw)
+{
+    i2c_dev_t *dev = &adc_devs[ADC_DEV_PRIMARY];
+
+    /* Config, threshold and the conversion read in a single transaction */
+    if (arm)
+        return adc_check(ads111x_set_comp(dev, ADS111X_COMP_MODE_WINDOW,
+                                          ADC_TRIP_HIGH_THRESH, raw));
+
+    return adc_check(ads111x_set_comp(dev, ADS111X_COMP_MODE_NORMAL,
+                                      ADC_RDY_HIGH_THRESH, raw));
+}
+
+/*
+ * Nothing is due and the trip channel conversion is running: arm the
+ * comparator and sleep until the next channel is due or ALERT trips. The
+ * trip channel is converted all the time while parked, its latest value is
+ * returned in sample.
+ */
+static esp_err_t adc_park(adc_sample_t *sample)
+{
+    TickType_t start = xTaskGetTickCount();
+    int16_t raw;
+
+    if (adc_trip_arm(true, NULL) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "ADC failed to arm the power fail trip!");
+        adc_trip_arm(false, NULL);
+        return ESP_FAIL;
+    }
+
+    /* From now on a falling edge means the comparator tripped */
+    xSemaphoreTake(adc_rdy_sem, 0);
+    sample->trip = xSemaphoreTake(adc_rdy_sem, adc_park_ticks()) == pdTRUE;
+
+    if (adc_trip_arm(false, &raw) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "ADC failed to leave the power fail trip!");
+        return ESP_FAIL;
+    }
+
+    /* Account for the slots spent parked */
+    adc_slot += ((xTaskGetTickCount() - start) * portTICK_RATE_MS) / adc_period_ms;
+
+    sample->chan = adc_trip_chan;
+    sample->raw = raw;
+    sample->gain = adc_chan_gain[adc_trip_chan];
+    sample->tick = xTaskGetTickCount();
+    sample->us = (uint32_t)esp_timer_get_time();
+
+    if (sample->trip)
+        ESP_LOGI(TAG, "ADC power fail trip, raw value %d", raw);
+
+    return ESP_OK;
+}
+
+/* Pick the gain of the next conversion of chan from the last reading */
+static void adc_range(int chan, int16_t raw, ads111x_gain_t gain)
+{
+    int mag = raw < 0 ? -raw : raw;
+
+    /* The next conversion may already run with the new gain */
+    if (gain != adc_chan_gain[chan])
+        return;
+
+    if (mag > ADC_RANGE_DOWN && gain > ADC_GAIN)
+        adc_chan_gain[chan] = gain - 1;
+    else if (mag < ADC_RANGE_UP && gain < adc_chan_gain_max[chan])
+        adc_chan_gain[chan] = gain + 1;
+}
+
+static void adc_post_sample(adc_sample_t *sample)
+{
+    sample->voltage = adc_raw_to_mv(sample->chan, sample->raw, sample->gain);
+    filter_update(&adc_filters[sample->chan], sample->voltage);
+    sample->filtered = adc_filters[sample->chan].out;
+    adc_stats.samples++;
+    ESP_LOGV(TAG, "ADC chan %d raw value %d, voltage: %d mV\n",
+             adc_chans[sample->chan].mux, sample->raw, sample->voltage);
+
+    /* A scan sample below the threshold trips like the comparator does */
+    if (sample->chan == adc_trip_chan)
+    {
+        if (adc_trip_armed && sample->raw < adc_trip_raw && !sample->trip)
+        {
+            ESP_LOGI(TAG, "ADC power fail trip on scan, raw value %d", sample->raw);
+            sample->trip = true;
+        }
+        adc_trip_armed = sample->raw >= adc_trip_raw;
+    }
+
+    if (sample->chan == adc_cal_chan && adc_cal_count < ADC_CAL_SAMPLES)
+    {
+        adc_cal_sum += sample->raw * (1 << (ADC_GAIN_STEP_MAX - (sample->gain - ADC_GAIN)));
+        adc_cal_count++;
+    }
+
+    /* Clipped at the lowest gain, the input is beyond full scale */
+    if (sample->gain == ADC_GAIN &&
+        (sample->raw >= ADS111X_MAX_VALUE || sample->raw <= -ADS111X_MAX_VALUE))
+        adc_fault(ADC_FAULT_RANGE);
+
+    adc_range(sample->chan, sample->raw, sample->gain);
+
+    /* A trip goes first, the power off path must not wait for older samples */
+    if (sample->trip)
+    {
+        if (xQueueSendToFront(adc_queue, sample, 0) != pdPASS)
+        {
+            /* Make room for it */
+            adc_sample_t old;
+
+            xQueueReceive(adc_queue, &old, 0);
+            xQueueSendToFront(adc_queue, sample, 0);
+            adc_stats.dropped++;
+        }
+    }
+    else if (xQueueSend(adc_queue, sample, 0) != pdPASS)
+    {
+        adc_stats.dropped++;
+    }
+}
+
+/*
+ * Queue the reads of the conversions started on the previous pulse, they go
+ * out right behind the primary device one while its sample is processed.
+ */
+static void adc_aux_read(void)
+{
+    int dev;
+
+    for (dev = ADC_DEV_PRIMARY + 1; dev < adc_dev_count; dev++)
+    {
+        if (adc_aux_chan[dev] < 0)
+            continue;
+
+        if (adc_check(ads111x_get_value_async(&adc_devs[dev], &adc_reads[dev])) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "ADC read failed on dev %d chan %d!",
+                     dev, adc_chans[adc_aux_chan[dev]].mux);
+            adc_aux_chan[dev] = -1;
+            continue;
+        }
+        adc_aux_reading[dev] = true;
+    }
+}
+
+/* Wait for the queued reads and drop them, on a failed slot */
+static void adc_aux_drop(void)
+{
+    int16_t raw;
+    int dev;
+
+    for (dev = ADC_DEV_PRIMARY + 1; dev < adc_dev_count; dev++)
+    {
+        if (!adc_aux_reading[dev])
+            continue;
+
+        ads111x_get_value_wait(&adc_reads[dev], &raw);
+        adc_aux_reading[dev] = false;
+        adc_aux_chan[dev] = -1;
+    }
+}
+
+/*
+ * Called on every ready pulse of the primary device: collect the conversions
+ * read by adc_aux_read() and start the next ones, back to back, so all
+ * devices convert in parallel within one slot.
+ */
+static void adc_aux_slot(void)
+{
+    adc_sample_t sample;
+    int16_t raw;
+    int dev, chan;
+
+    for (dev = ADC_DEV_PRIMARY + 1; dev < adc_dev_count; dev++)
+    {
+        chan = adc_aux_chan[dev];
+        if (chan >= 0 && adc_aux_reading[dev])
+        {
+            adc_aux_chan[dev] = -1;
+            adc_aux_reading[dev] = false;
+            if (adc_check(ads111x_get_value_wait(&adc_reads[dev], &raw)) != ESP_OK)
+            {
+                ESP_LOGE(TAG, "ADC read failed on dev %d chan %d!",
+                         dev, adc_chans[chan].mux);
+            }
+            else
+            {
+                sample.chan = chan;
+                sample.raw = raw;
+                sample.gain = adc_aux_gain[dev];
+                sample.tick = xTaskGetTickCount();
+                sample.us = (uint32_t)esp_timer_get_time();
+                sample.trip = false;
+                adc_post_sample(&sample);
+            }
+        }
+
+        chan = adc_pick(dev, false);
+        if (chan < 0)
+            continue;
+
+        if (adc_set_input(chan, adc_chan_gain[chan], true) != ESP_OK)
+            continue;
+        adc_aux_chan[dev] = chan;
+        adc_aux_gain[dev] = adc_chan_gain[chan];
+    }
+}
+
+/* Called on every failed slot, the caller resyncs afterwards */
+static void adc_heal(void)
+{
+    uint32_t fails = ++adc_fail_count;
+    i2cdev_bus_stats_t bus;
+    bool recovered = false;
+
+    if (i2cdev_get_bus_stats(adc_devs[ADC_DEV_PRIMARY].port, &bus) == ESP_OK &&
+        bus.recoveries != adc_bus_recoveries)
+    {
+        adc_stats.recoveries += bus.recoveries - adc_bus_recoveries;
+        adc_bus_recoveries = bus.recoveries;
+        recovered = !bus.stuck;
+    }
+
+    if (!recovered && fails % ADC_FAIL_SETUP)
+    {
+        /* Leave the bus and the CPU to the others while failing */
+        if (fails > ADC_FAIL_SETUP)
+            vTaskDelay(ADC_FAIL_BACKOFF_MS / portTICK_RATE_MS);
+        return;
+    }
+
+    ESP_LOGE(TAG, "ADC %u failed slots, programming the devices again!", fails);
+    adc_stats.resets++;
+    if (adc_setup() != ESP_OK)
+        ESP_LOGE(TAG, "ADC could not program the devices!");
+}
+
+/*
+ * The mux for the next slot is written while the current conversion runs and
+ * the result of the previous one is converted and queued, so every ready
+ * pulse yields a valid sample.
+ */
+static void adc_task(void *arg)
+{
+    adc_sample_t sample;
+    int cur, next, pending;
+    ads111x_gain_t cur_gain = ADC_GAIN, pending_gain;
+    int16_t raw;
+    esp_err_t err;
+    bool synced = false;
+
+    cur = adc_schedule(false);
+
+    while (1)
+    {
+        if (adc_scale_pending)
+            adc_cal_apply();
+
+        if (!synced)
+        {
+            if (adc_sync(cur) != ESP_OK)
+            {
+                adc_heal();
+                vTaskDelay(1);
+                continue;
+            }
+            cur_gain = adc_chan_gain[cur];
+            synced = true;
+        }
+
+        next = adc_schedule(adc_trip_chan >= 0 && adc_trip_armed);
+        pending = next == ADC_PARK ? adc_trip_chan : next;
+        pending_gain = adc_chan_gain[pending];
+        if ((adc_chans[pending].mux != adc_chans[cur].mux ||
+             pending_gain != cur_gain) &&
+            adc_set_input(pending, pending_gain, false) != ESP_OK)
+        {
+            adc_heal();
+            synced = false;
+            cur = adc_schedule(false);
+            continue;
+        }
+
+        /* Reads of every device are queued back to back */
+        err = adc_wait_rdy();
+        if (err == ESP_OK)
+        {
+            err = adc_check(ads111x_get_value_async(&adc_devs[ADC_DEV_PRIMARY],
+                                                    &adc_reads[ADC_DEV_PRIMARY]));
+            adc_aux_read();
+            if (err == ESP_OK)
+                err = adc_check(ads111x_get_value_wait(&adc_reads[ADC_DEV_PRIMARY], &raw));
+        }
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "ADC read failed on chan %d!", adc_chans[cur].mux);
+            adc_aux_drop();
+            adc_heal();
+            synced = false;
+            cur = adc_schedule(false);
+            continue;
+        }
+
+        if (adc_fail_count >= ADC_FAIL_SETUP)
+            ESP_LOGI(TAG, "ADC recovered after %u failed slots", adc_fail_count);
+        adc_fail_count = 0;
+
+        sample.chan = cur;
+        sample.raw = raw;
+        sample.gain = cur_gain;
+        sample.tick = xTaskGetTickCount();
+        sample.us = (uint32_t)esp_timer_get_time();
+        sample.trip = false;
+
+        /* The next conversion is running and the other reads are on the bus */
+        adc_post_sample(&sample);
+
+        adc_aux_slot();
+
+        if (next != ADC_PARK)
+        {
+            cur = next;
+            cur_gain = pending_gain;
+            continue;
+        }
+
+        /* The trip channel conversion is running, park on it */
+        if (adc_park(&sample) != ESP_OK)
+            adc_heal();
+        else
+            adc_post_sample(&sample);
+
+        synced = false;
+        cur = adc_schedule(false);
+    }
+}
+
+esp_err_t adc_set_trip(int chan, int voltage)
+{
+    if (chan >= ADC_CHAN_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    adc_trip_chan = chan < 0 ? -1 : chan;
+    adc_trip_voltage = voltage;
+
+    return ESP_OK;
+}
+
+esp_err_t adc_start(const adc_chan_cfg_t *chans, int count)
+{
+    bool primary = false;
+    int i;
+
+    if (!chans || count <= 0 || count > ADC_CHAN_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    /* The primary device paces the scan, it needs at least one channel */
+    for (i = 0; i < count; i++)
+    {
+        if (chans[i].dev >= adc_dev_count)
+            return ESP_ERR_INVALID_ARG;
+        if (chans[i].dev == ADC_DEV_PRIMARY)
+            primary = true;
+    }
+    if (!primary)
+        return ESP_ERR_INVALID_ARG;
+
+    adc_chans = chans;
+    adc_chan_count = count;
+    for (i = 0; i < count; i++)
+    {
+        adc_chan_due[i] = 0;
+        filter_init(&adc_filters[i], &chans[i].filter);
+        adc_cal_load(i);
+
+        /* The trip threshold is a raw value at ADC_GAIN */
+        adc_chan_gain[i] = ADC_GAIN;
+        adc_chan_gain_max[i] = ADC_GAIN;
+        if (i != adc_trip_chan && chans[i].gain_max > ADC_GAIN)
+            adc_chan_gain_max[i] = chans[i].gain_max > ADS111X_GAIN_0V256 ?
+                                   ADS111X_GAIN_0V256 : chans[i].gain_max;
+    }
+
+    /* ALERT/RDY is only connected on the primary device */
+    if (adc_trip_chan >= count ||
+        (adc_trip_chan >= 0 && chans[adc_trip_chan].dev != ADC_DEV_PRIMARY))
+        return ESP_ERR_INVALID_ARG;
+
+    if (adc_trip_chan >= 0 && adc_trip_set_thresh() != ESP_OK)
+        return ESP_FAIL;
+
+    adc_queue = xQueueCreate(ADC_QUEUE_LEN, sizeof(adc_sample_t));
+    if (adc_queue == NULL)
+    {
+        ESP_LOGE(TAG, "ADC could not create sample queue!");
+        return ESP_FAIL;
+    }
+
+    if (xTaskCreate(adc_task, "adc_task", ADC_TASK_STACK_SIZE, NULL,
+        ADC_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG, "ADC task could not be created!");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t adc_get_sample(adc_sample_t *sample, TickType_t wait)
+{
+    if (xQueueReceive(adc_queue, sample, wait) != pdTRUE)
+        return ESP_ERR_TIMEOUT;
+
+    return ESP_OK;
+}
+
+void adc_get_stats(adc_stats_t *stats)
+{
+    int i;
+
+    memcpy(stats, &adc_stats, sizeof(adc_stats_t));
+    stats->i2c_transactions = 0;
+    for (i = 0; i < adc_dev_count; i++)
+        stats->i2c_transactions += ads111x_get_transactions(&adc_devs[i]);
+}
+
+/* Average ADC_CAL_SAMPLES conversions of chan, the sum is returned */
+static esp_err_t adc_cal_capture(int chan, int32_t *sum)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout;
+
+    timeout = (2 * ADC_CAL_SAMPLES * adc_chans[chan].period * adc_period_ms +
+               ADC_CAL_TIMEOUT_MS) / portTICK_RATE_MS;
+
+    adc_cal_sum = 0;
+    adc_cal_count = 0;
+    adc_cal_chan = chan;
+
+    while (adc_cal_count < ADC_CAL_SAMPLES)
+    {
+        if (xTaskGetTickCount() - start > timeout)
+        {
+            adc_cal_chan = -1;
+            ESP_LOGE(TAG, "ADC chan %d calibration timeout!", chan);
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(100 / portTICK_RATE_MS);
+    }
+
+    adc_cal_chan = -1;
+    *sum = adc_cal_sum;
+
+    return ESP_OK;
+}
+
+esp_err_t adc_cal_point(int chan, int point, int voltage)
+{
+    adc_cal_t cal;
+    int32_t sum, span;
+    char key[16];
+
+    if (!adc_queue || chan < 0 || chan >= adc_chan_count ||
+        point < 0 || point > 1)
+        return ESP_ERR_INVALID_ARG;
+
+    if (point == 1 && !(adc_cal_ref_valid & (1 << chan)))
+    {
+        ESP_LOGE(TAG, "ADC chan %d calibration point 0 missing!", chan);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (adc_cal_capture(chan, &sum) != ESP_OK)
+        return ESP_FAIL;
+
+    ESP_LOGI(TAG, "ADC chan %d calibration point %d: %d mV, raw %d",
+             chan, point, voltage, (int)(sum / ADC_CAL_SCALE));
+
+    if (point == 0)
+    {
+        adc_cal_ref_sum[chan] = sum;
+        adc_cal_ref_mv[chan] = voltage;
+        adc_cal_ref_valid |= 1 << chan;
+        return ESP_OK;
+    }
+
+    adc_cal_ref_valid &= ~(1 << chan);
+
+    span = sum - adc_cal_ref_sum[chan];
+    if (span < ADC_CAL_MIN_SPAN * ADC_CAL_SCALE &&
+        span > -ADC_CAL_MIN_SPAN * ADC_CAL_SCALE)
+    {
+        ESP_LOGE(TAG, "ADC chan %d calibration points too close!", chan);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* The sums keep the averaging and gain bits, raw values are ADC_CAL_SCALE times larger */
+    cal.full_scale = ((int64_t)(voltage - adc_cal_ref_mv[chan]) *
+                      ADS111X_MAX_VALUE * ADC_CAL_SCALE) / span;
+    cal.offset = adc_cal_ref_mv[chan] -
+                 ((int64_t)adc_cal_ref_sum[chan] * cal.full_scale) /
+                 ((int64_t)ADS111X_MAX_VALUE * ADC_CAL_SCALE);
+    if (!adc_cal_valid(&cal))
+    {
+        ESP_LOGE(TAG, "ADC chan %d calibration out of range!", chan);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    adc_cal_key(chan, key, sizeof(key));
+    if (!nvs_get_handle() ||
+        nvs_set_blob(nvs_get_handle(), key, &cal, sizeof(cal)) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "ADC chan %d failed to save the calibration!", chan);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "ADC chan %d calibrated: full scale %d mV, offset %d mV",
+             chan, (int)cal.full_scale, (int)cal.offset);
+
+    adc_cal_set(chan, &cal);
+
+    return ESP_OK;
+}
+
+esp_err_t adc_cal_clear(int chan)
+{
+    adc_cal_t cal;
+    char key[16];
+    esp_err_t ret;
+
+    if (!adc_queue || chan < 0 || chan >= adc_chan_count)
+        return ESP_ERR_INVALID_ARG;
+
+    adc_cal_key(chan, key, sizeof(key));
+    if (nvs_get_handle())
+    {
+        ret = nvs_erase_key(nvs_get_handle(), key);
+        if (ret != ESP_OK && ret != ESP_ERR_NVS_NOT_FOUND)
+        {
+            ESP_LOGE(TAG, "ADC chan %d failed to erase the calibration!", chan);
+            return ESP_FAIL;
+        }
+    }
+
+    ESP_LOGI(TAG, "ADC chan %d calibration cleared", chan);
+
+    adc_cal_ref_valid &= ~(1 << chan);
+    cal.full_scale = adc_chans[chan].full_scale;
+    cal.offset = 0;
+    adc_cal_set(chan, &cal);
+
+    return ESP_OK;
+}
+
+esp_err_t adc_bench(uint32_t stretch_tick, uint32_t count, i2cdev_bench_t *res)
+{
+    uint8_t reg = ADC_REG_CONVERSION;
+    uint8_t buf[2];
+
+    if (!adc_dev_count || !count || count > ADC_BENCH_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    /* The driver would be reinstalled between every bench and scan read */
+    if (adc_queue != NULL && stretch_tick &&
+        stretch_tick != i2c_dev_get_stretch_tick(&adc_devs[ADC_DEV_PRIMARY]))
+    {
+        ESP_LOGE(TAG, "ADC bench stretch %u differs from the scan one!", stretch_tick);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return i2cdev_bench(adc_devs[ADC_DEV_PRIMARY].port, adc_devs[ADC_DEV_PRIMARY].addr,
+                        stretch_tick, &reg, 1, buf, sizeof(buf), count, res);
+}
+
+esp_err_t adc_get_cal(int chan, adc_cal_t *cal)
+{
+    if (!adc_queue || chan < 0 || chan >= adc_chan_count)
+        return ESP_ERR_INVALID_ARG;
+
+    taskENTER_CRITICAL();
+    if (adc_scale_pending & (1 << chan))
+        *cal = adc_scale_new[chan].cal;
+    else
+        *cal = adc_scale[chan].cal;
+    taskEXIT_CRITICAL();
+
+    return ESP_OK;
+}
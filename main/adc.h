@@ -0,0 +1,171 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __ADC_H__
+#define __ADC_H__
+
+#include "freertos/FreeRTOS.h"
+
+#include "ads111x.h"
+#include "i2cdev.h"
+#include "filter.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Max number of ADS111x devices, one per address */
+#define ADC_DEV_MAX                    4
+
+/* Max number of channels handled by the scan scheduler */
+#define ADC_CHAN_MAX                   16
+
+/* PGA gain of the channel full scale, the base of the auto gain ranging */
+#define ADC_GAIN                       ADS111X_GAIN_2V048
+
+/* Raw conversions averaged for every calibration point */
+#define ADC_CAL_SAMPLES                16
+
+/* Max adc_bench() transactions, the command task waits for the whole run */
+#define ADC_BENCH_MAX                  256
+
+/*
+ * Scan scheduler channel settings. A channel is due every period conversion
+ * slots, the highest priority due channel of every device gets the next slot.
+ * Free slots go to the highest priority channel, so the sum of 1 / period
+ * over the channels of a device should stay below 1 for every channel to get
+ * its rate. All devices convert in parallel, adding one does not make the
+ * slots longer.
+ *
+ * The channel unit is set by full_scale, mV for a voltage divider or mA for a
+ * current shunt. With gain_max above ADC_GAIN the PGA gain of the channel
+ * follows its readings up to gain_max, for small signals like a shunt. Gain
+ * ranging is never done on the power fail trip channel.
+ */
+typedef struct {
+    ads111x_mux_t mux;
+    int full_scale;             /* At ADS111X_MAX_VALUE and ADC_GAIN when not calibrated */
+    uint16_t period;
+    uint8_t priority;
+    filter_cfg_t filter;        /* Applied to the voltage of every sample */
+    ads111x_gain_t gain_max;    /* Auto gain ranging limit */
+    uint8_t dev;                /* Index in the adc_init() device table */
+} adc_chan_cfg_t;
+
+typedef struct {
+    uint8_t chan;               /* Index in the channel table */
+    int16_t raw;
+    uint8_t gain;               /* ads111x_gain_t of the conversion */
+    int voltage;                /* Channel unit, mV */
+    int filtered;               /* Latest channel filter output */
+    TickType_t tick;
+    uint32_t us;                /* esp_timer time of the read, wraps */
+    bool trip;                  /* Power fail comparator tripped */
+} adc_sample_t;
+
+/*
+ * Channel calibration, saved in the NVS:
+ * voltage = raw * full_scale / ADS111X_MAX_VALUE + offset
+ */
+typedef struct {
+    int32_t full_scale;         /* mV */
+    int32_t offset;             /* mV */
+} adc_cal_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t i2c_transactions;
+    uint32_t errors;            /* Sum of the fault classes below */
+    uint32_t dropped;
+    uint32_t nack;              /* Device did not acknowledge */
+    uint32_t i2c_timeout;       /* Bus or driver timeout */
+    uint32_t rdy_timeout;       /* No conversion ready pulse */
+    uint32_t out_of_range;      /* Reading clipped at the lowest gain */
+    uint32_t resets;            /* Devices programmed again after failures */
+    uint32_t recoveries;        /* i2cdev bus recoveries while failing */
+} adc_stats_t;
+
+/*
+ * Init count ADS111x devices at the given addresses. The first one is the
+ * primary device: continuous conversion mode with the ALERT/RDY pin
+ * configured as conversion ready output and connected to alert_gpio, it sets
+ * the pace of the scan. The others convert in single shot mode, started on
+ * every ready pulse of the primary device.
+ */
+esp_err_t adc_init(i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio,
+                   gpio_num_t alert_gpio, const uint8_t *addrs, int count);
+
+/*
+ * Start the scan task for the given channel table. The table is not copied
+ * and must stay valid.
+ */
+esp_err_t adc_start(const adc_chan_cfg_t *chans, int count);
+
+/*
+ * Enable the power fail trip on channel chan, an index in the channel table,
+ * which must be on the primary device.
+ * It is disabled when chan is negative and must be set before adc_start().
+ *
+ * When no channel is due and the last chan sample was above voltage, the
+ * engine parks the mux on chan with ALERT/RDY switched to window comparator
+ * below voltage. While other channels are due, chan takes every other slot
+ * and a sample below voltage trips as well. A trip is reported within one
+ * conversion period while parked and within two while scanning, as a chan
+ * sample with the trip flag set, queued ahead of everything else.
+ */
+esp_err_t adc_set_trip(int chan, int voltage);
+
+/* Get the next sample, waiting at most wait ticks */
+esp_err_t adc_get_sample(adc_sample_t *sample, TickType_t wait);
+
+void adc_get_stats(adc_stats_t *stats);
+
+/*
+ * Two point calibration of channel chan against a known reference. Apply
+ * voltage (mV) on the input and call it for point 0, then for point 1 with a
+ * second voltage. Each call blocks until ADC_CAL_SAMPLES conversions of chan
+ * are averaged. Point 1 computes the calibration, saves it in the NVS and
+ * hands it to the scan task.
+ */
+esp_err_t adc_cal_point(int chan, int point, int voltage);
+
+/* Drop the saved calibration of chan and go back to the table full scale */
+esp_err_t adc_cal_clear(int chan);
+
+esp_err_t adc_get_cal(int chan, adc_cal_t *cal);
+
+/*
+ * Time count reads of the primary device conversion register with the given
+ * clock stretch timeout, see i2cdev_bench(). The reads are queued at low
+ * priority, the scan keeps going. Once the scan is started only its own
+ * stretch timeout is accepted. count is limited to ADC_BENCH_MAX.
+ */
+esp_err_t adc_bench(uint32_t stretch_tick, uint32_t count, i2cdev_bench_t *res);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADC_H__ */
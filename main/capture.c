@@ -0,0 +1,153 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "capture.h"
+
+#define CAPTURE_MASK                   (CAPTURE_LEN - 1)
+
+/* Single core, the barrier keeps the compiler from reordering around it */
+#define capture_barrier()              __sync_synchronize()
+
+static capture_entry_t capture_ring[CAPTURE_LEN];
+
+/* Written by the producer only */
+static volatile uint32_t capture_head;
+static uint32_t capture_post;
+static uint32_t capture_trigger_head;
+static uint32_t capture_trigger_us;
+static uint8_t capture_reason;
+
+/* ARMED -> TRIGGERED -> FROZEN by the producer, FROZEN -> ARMED by the consumer */
+static volatile capture_state_t capture_state = CAPTURE_ARMED;
+
+void capture_push(const adc_sample_t *sample)
+{
+    capture_entry_t *entry;
+    uint32_t head;
+
+    if (capture_state == CAPTURE_FROZEN)
+        return;
+
+    head = capture_head;
+    entry = &capture_ring[head & CAPTURE_MASK];
+    entry->us = sample->us;
+    entry->raw = sample->raw;
+    entry->chan = sample->chan;
+    entry->flags = (sample->trip ? CAPTURE_FLAG_TRIP : 0) |
+                   ((sample->gain << CAPTURE_FLAG_GAIN_SHIFT) & CAPTURE_FLAG_GAIN_MASK);
+
+    capture_barrier();
+    capture_head = head + 1;
+
+    if (capture_state == CAPTURE_TRIGGERED && --capture_post == 0)
+    {
+        capture_barrier();
+        capture_state = CAPTURE_FROZEN;
+    }
+}
+
+void capture_trigger(capture_reason_t reason)
+{
+    /* Keep the first event, the following ones are part of its transient */
+    if (capture_state != CAPTURE_ARMED || !capture_head)
+        return;
+
+    /* The sample that fired the trigger is the last one pushed */
+    capture_reason = reason;
+    capture_trigger_head = capture_head - 1;
+    capture_trigger_us = capture_ring[capture_trigger_head & CAPTURE_MASK].us;
+    capture_post = CAPTURE_POST;
+
+    capture_barrier();
+    capture_state = CAPTURE_TRIGGERED;
+}
+
+capture_state_t capture_get_state(void)
+{
+    return capture_state;
+}
+
+/* Oldest entry kept, only valid once frozen */
+static uint32_t capture_start(void)
+{
+    uint32_t pre = capture_trigger_head;
+
+    if (pre > CAPTURE_LEN - CAPTURE_POST - 1)
+        pre = CAPTURE_LEN - CAPTURE_POST - 1;
+
+    return capture_trigger_head - pre;
+}
+
+esp_err_t capture_get_info(capture_hdr_t *hdr)
+{
+    if (capture_state != CAPTURE_FROZEN)
+        return ESP_ERR_INVALID_STATE;
+
+    capture_barrier();
+
+    memset(hdr, 0, sizeof(capture_hdr_t));
+    hdr->magic = CAPTURE_MAGIC;
+    hdr->version = CAPTURE_VERSION;
+    hdr->reason = capture_reason;
+    hdr->total = capture_head - capture_start();
+    hdr->trigger = capture_trigger_head - capture_start();
+    hdr->trigger_us = capture_trigger_us;
+
+    return ESP_OK;
+}
+
+int capture_read(int first, capture_entry_t *entries, int count)
+{
+    uint32_t start, total;
+    int i;
+
+    if (capture_state != CAPTURE_FROZEN || first < 0)
+        return 0;
+
+    capture_barrier();
+
+    start = capture_start();
+    total = capture_head - start;
+    if ((uint32_t)first >= total)
+        return 0;
+    if ((uint32_t)count > total - first)
+        count = total - first;
+
+    for (i = 0; i < count; i++)
+        entries[i] = capture_ring[(start + first + i) & CAPTURE_MASK];
+
+    return count;
+}
+
+void capture_arm(void)
+{
+    if (capture_state != CAPTURE_FROZEN)
+        return;
+
+    capture_barrier();
+    capture_state = CAPTURE_ARMED;
+}
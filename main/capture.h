@@ -0,0 +1,116 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "adc.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Power event capture: a ring of raw samples of every channel, written by the
+ * main task only and read by the command task only once frozen, so no lock
+ * is needed. The trigger is the last sample pushed, CAPTURE_POST more are
+ * written after it, then the ring freezes with up to CAPTURE_LEN samples,
+ * ~8s at 64 SPS, until capture_arm() is called.
+ */
+#define CAPTURE_LEN                    512      /* Power of 2 */
+#define CAPTURE_POST                   256
+
+/* Blob layout version, bump on any change of the structures below */
+#define CAPTURE_VERSION                2
+#define CAPTURE_MAGIC                  0x5543   /* "CU" in little endian */
+
+typedef enum {
+    CAPTURE_ARMED,
+    CAPTURE_TRIGGERED,
+    CAPTURE_FROZEN,
+} capture_state_t;
+
+typedef enum {
+    CAPTURE_NONE,
+    CAPTURE_POWER_OFF,
+    CAPTURE_BAT_DISCONNECT,
+} capture_reason_t;
+
+/* Entry flags, the PGA gain of the conversion is kept in the upper bits */
+#define CAPTURE_FLAG_TRIP              0x01
+#define CAPTURE_FLAG_GAIN_SHIFT        4
+#define CAPTURE_FLAG_GAIN_MASK         0x70
+
+/* Little endian, 8 bytes */
+typedef struct {
+    uint32_t us;                /* esp_timer time, low 32 bits */
+    int16_t raw;
+    uint8_t chan;               /* Index in the ADC channel table */
+    uint8_t flags;
+} __attribute__((packed)) capture_entry_t;
+
+/*
+ * Header of every blob chunk, followed by count entries. Entries come in
+ * queue order, a power fail trip sample may be ahead of older samples.
+ */
+typedef struct {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t reason;             /* capture_reason_t */
+    uint16_t total;             /* Entries in the whole capture */
+    uint16_t first;             /* Index of the first entry in this chunk */
+    uint16_t trigger;           /* Index of the entry that fired the trigger */
+    uint8_t count;              /* Entries in this chunk */
+    uint8_t reserved;
+    uint32_t trigger_us;        /* us of the trigger entry */
+} __attribute__((packed)) capture_hdr_t;
+
+/* Producer side, main task only */
+void capture_push(const adc_sample_t *sample);
+void capture_trigger(capture_reason_t reason);
+
+/* Consumer side */
+capture_state_t capture_get_state(void);
+
+/*
+ * Get the frozen capture: the header with total, trigger, reason and
+ * trigger_us set. Fails unless the state is CAPTURE_FROZEN.
+ */
+esp_err_t capture_get_info(capture_hdr_t *hdr);
+
+/* Copy at most count entries starting at index first, returns the number copied */
+int capture_read(int first, capture_entry_t *entries, int count);
+
+/* Release a frozen capture and wait for the next trigger */
+void capture_arm(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CAPTURE_H__ */
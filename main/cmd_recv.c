@@ -39,6 +39,10 @@
 #include "cJSON.h"
 #include "nvs_utils.h"
  #include "ups.h"
+#include "adc.h"
+#include "capture.h"
+#include "i2cdev.h"
+#include "ssd1306.h"
 
 #include "cmd_recv.h"
 
@@ -51,10 +55,19 @@
 #define MQTT_SUB_QOS              1
 #define MQTT_PUB_TOPIC_PREFIX     "sensors/data/"
 #define MQTT_PUB_QOS              1
+#define MQTT_CAP_TOPIC_PREFIX     "sensors/capture/"
+
+/* Capture entries per MQTT message, the lwIP MQTT output buffer is small */
+#define CMD_CAP_CHUNK_ENTRIES     24
+#define CMD_CAP_RETRIES           20
+#define CMD_CAP_RETRY_DELAY       100
 
 /* Max number of commands to queue */
 #define CMD_PARSE_QUEUE_LEN       5
 
+/* Default transactions per device of an I2C benchmark */
+#define CMD_BENCH_COUNT           100
+
 /* JSON command fields */
 #define CMD_JSON_CMD             "cmd"
 #define CMD_JSON_TIME            "time"
@@ -72,6 +85,21 @@
 #define CMD_JSON_BATC            "bat_connected"
 #define CMD_JSON_FAN             "fan_high"
 #define CMD_JSON_ADC_ERR         "adc_err"
+#define CMD_JSON_ADC_SAMPLES     "adc_smp"
+#define CMD_JSON_ADC_I2C         "adc_i2c"
+#define CMD_JSON_ADC_NACK        "adc_nack"
+#define CMD_JSON_ADC_I2C_TIMEOUT "adc_tmo"
+#define CMD_JSON_ADC_RDY_TIMEOUT "adc_rdy"
+#define CMD_JSON_ADC_RANGE       "adc_rng"
+#define CMD_JSON_ADC_RESETS      "adc_rst"
+#define CMD_JSON_ADC_RECOVERIES  "adc_rec"
+#define CMD_JSON_ADC_STALE       "adc_stale"
+#define CMD_JSON_I2C_ALLOCS      "i2c_alloc"
+#define CMD_JSON_I2C_REUSES      "i2c_reuse"
+#define CMD_JSON_I2C_RECOVERIES  "i2c_rec"
+#define CMD_JSON_I2C_REC_FAILS   "i2c_rec_fail"
+#define CMD_JSON_I2C_REC_MAX     "i2c_rec_us"
+#define CMD_JSON_I2C_STUCK       "i2c_stuck"
 #define CMD_JSON_UPTIME          "up"
 #define CMD_JSON_FW_VER          "fw_v"
 #define CMD_JSON_HEAP            "heap"
@@ -80,6 +108,36 @@
 #define CMD_JSON_FILENAME        "file"
 #define CMD_JSON_AP_MODE         "ap"
 #define CMD_JSON_BRIGHTNESS      "b"
+#define CMD_JSON_ADC_CHAN        "chan"
+#define CMD_JSON_ADC_POINT       "point"
+#define CMD_JSON_ADC_MV          "mv"
+#define CMD_JSON_ADC_FULL_SCALE  "fs"
+#define CMD_JSON_ADC_OFFSET      "ofs"
+#define CMD_JSON_CAP_ARM         "arm"
+#define CMD_JSON_CAP_STATE       "state"
+#define CMD_JSON_CAP_REASON      "reason"
+#define CMD_JSON_CAP_COUNT       "n"
+#define CMD_JSON_BENCH_HZ        "hz"
+#define CMD_JSON_BENCH_STRETCH   "stretch"
+#define CMD_JSON_BENCH_COUNT     "n"
+#define CMD_JSON_BENCH_ADC       "adc"
+#define CMD_JSON_BENCH_OLED      "oled"
+#define CMD_JSON_BENCH_ERRORS    "err"
+#define CMD_JSON_BENCH_BPS       "bps"
+#define CMD_JSON_BENCH_LAT_MIN   "lat_min"
+#define CMD_JSON_BENCH_LAT_AVG   "lat_avg"
+#define CMD_JSON_BENCH_LAT_MAX   "lat_max"
+#define CMD_JSON_I2C_CLEAR       "clear"
+#define CMD_JSON_I2C_ADDR        "addr"
+#define CMD_JSON_I2C_COUNT       "n"
+#define CMD_JSON_I2C_BYTES       "bytes"
+#define CMD_JSON_I2C_NACK        "nack"
+#define CMD_JSON_I2C_TIMEOUT     "tmo"
+#define CMD_JSON_I2C_ERR         "err"
+#define CMD_JSON_I2C_BUSY        "busy"
+#define CMD_JSON_I2C_WAIT        "wait"
+#define CMD_JSON_I2C_WAIT_MAX    "wait_max"
+#define CMD_JSON_I2C_LAT         "lat"
 
 
 /* Delay between MQTT publish attempts */
@@ -98,6 +156,7 @@ static xQueueHandle cmd_recv_queue = NULL;
 static mqtt_client_info_t mqtt_client_info;
 
 static char * mqtt_pub_topic;
+static char * mqtt_cap_topic;
 static char * mqtt_client_id;
 
 static void do_reboot()
@@ -197,6 +256,12 @@ static esp_err_t mqtt_start()
     }
     sprintf(mqtt_pub_topic, "%s%s", MQTT_PUB_TOPIC_PREFIX, mqtt_client_id);
 
+    mqtt_cap_topic = malloc(strlen(MQTT_CAP_TOPIC_PREFIX) + strlen(mqtt_client_id) + 1);
+    if (mqtt_cap_topic == NULL) {
+        goto error;
+    }
+    sprintf(mqtt_cap_topic, "%s%s", MQTT_CAP_TOPIC_PREFIX, mqtt_client_id);
+
     mqtt_client_info.broker = broker_ip;
     mqtt_client_info.sub_topic = sub_topic;
     mqtt_client_info.sub_qos = MQTT_SUB_QOS;
@@ -216,6 +281,7 @@ error:
     free(broker_ip);
     free(sub_topic);
     free(mqtt_pub_topic);
+    free(mqtt_cap_topic);
 
     return ESP_FAIL;
 }
@@ -393,6 +459,21 @@ static esp_err_t cmd_set_mqtt_broker_ip(cJSON *root)
  *         "p_off":        62,
  *         "fan_high":     false,
  *         "adc_err":      0,
+ *         "adc_smp":      4096,
+ *         "adc_i2c":      8200,
+ *         "adc_nack":     0,
+ *         "adc_tmo":      0,
+ *         "adc_rdy":      0,
+ *         "adc_rng":      0,
+ *         "adc_rst":      0,
+ *         "adc_rec":      0,
+ *         "adc_stale":    false,
+ *         "i2c_alloc":    0,
+ *         "i2c_reuse":    5120,
+ *         "i2c_rec":      1,
+ *         "i2c_rec_fail": 0,
+ *         "i2c_rec_us":   850,
+ *         "i2c_stuck":    false,
  *         "bat_discharged":       3,
  *         "bat_connected":        true
  * }
@@ -403,6 +484,15 @@ static esp_err_t send_ups_info(ups_data_t *ups_data)
     cJSON *root = NULL;
     char * string;
     esp_err_t ret;
+    i2cdev_cmd_stats_t i2c_stats;
+    i2cdev_bus_stats_t bus_stats;
+
+    /* Command links are only built for new transaction shapes */
+    memset(&i2c_stats, 0, sizeof(i2c_stats));
+    i2cdev_get_cmd_stats(I2C_NUM_0, &i2c_stats, true);
+
+    memset(&bus_stats, 0, sizeof(bus_stats));
+    i2cdev_get_bus_stats(I2C_NUM_0, &bus_stats);
 
     root = cJSON_CreateObject();
     if (root == NULL) {
@@ -423,6 +513,21 @@ static esp_err_t send_ups_info(ups_data_t *ups_data)
         !cJSON_AddNumberToObject(root, CMD_JSON_POFF, ups_data->power_off )     ||
         !cJSON_AddBoolToObject(root, CMD_JSON_FAN, ups_data->fan_high)          ||
         !cJSON_AddNumberToObject(root, CMD_JSON_ADC_ERR, ups_data->adc_errors)  ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_ADC_SAMPLES, ups_data->adc_samples) ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_ADC_I2C, ups_data->adc_i2c_transactions) ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_ADC_NACK, ups_data->adc_nack)   ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_ADC_I2C_TIMEOUT, ups_data->adc_i2c_timeout) ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_ADC_RDY_TIMEOUT, ups_data->adc_rdy_timeout) ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_ADC_RANGE, ups_data->adc_out_of_range) ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_ADC_RESETS, ups_data->adc_resets) ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_ADC_RECOVERIES, ups_data->adc_recoveries) ||
+        !cJSON_AddBoolToObject(root, CMD_JSON_ADC_STALE, ups_data->adc_stale)   ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_ALLOCS, i2c_stats.allocs)   ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_REUSES, i2c_stats.reuses)   ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_RECOVERIES, bus_stats.recoveries) ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_REC_FAILS, bus_stats.recovery_failures) ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_REC_MAX, bus_stats.recovery_max_us) ||
+        !cJSON_AddBoolToObject(root, CMD_JSON_I2C_STUCK, bus_stats.stuck)       ||
         !cJSON_AddNumberToObject(root, CMD_JSON_BATD, ups_data->bat_discharged) ||
         !cJSON_AddBoolToObject(root, CMD_JSON_BATC, ups_data->bat_connected)) {
         ESP_LOGE(TAG, "Could not add ups info to JSON!");
@@ -450,6 +555,394 @@ static esp_err_t cmd_set_display_brightness(cJSON *root)
     return ESP_FAIL;
 }
 
+static esp_err_t send_adc_cal(int chan, esp_err_t res)
+{
+    cJSON *root = NULL;
+    char * string;
+    adc_cal_t cal;
+    esp_err_t ret;
+
+    root = cJSON_CreateObject();
+    if (root == NULL) {
+        ESP_LOGE(TAG, "Could not create JSON object!");
+        return ESP_FAIL;
+    }
+
+    memset(&cal, 0, sizeof(cal));
+    adc_get_cal(chan, &cal);
+
+    if (!cJSON_AddNumberToObject(root, CMD_JSON_CMD, CMD_ADC_CALIBRATE)       ||
+        !cJSON_AddStringToObject(root, CMD_JSON_CLIENT_ID, mqtt_client_id)    ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_TIME, time(NULL))             ||
+        !cJSON_AddStringToObject(root, CMD_JSON_RESULT,
+                                 res == ESP_OK ? "OK" : "ERROR")              ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_ADC_CHAN, chan)               ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_ADC_FULL_SCALE, cal.full_scale) ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_ADC_OFFSET, cal.offset)) {
+        ESP_LOGE(TAG, "Could not add info to the response JSON!");
+
+        cJSON_Delete(root);
+        return ESP_FAIL;
+    }
+
+    string = cJSON_Print(root);
+
+    ret = mqtt_client_publish(mqtt_client_info.ctrl_handle,
+            mqtt_pub_topic, (const uint8_t*)string, strlen(string),
+            MQTT_PUB_QOS, 0);
+
+    /* Free allocated items */
+    cJSON_Delete(root);
+    free(string);
+
+    return ret;
+}
+
+static esp_err_t cmd_adc_calibrate(cJSON *root)
+{
+    cJSON * chan = NULL;
+    cJSON * point = NULL;
+    cJSON * voltage = NULL;
+    esp_err_t ret;
+
+    chan = cJSON_GetObjectItemCaseSensitive(root, CMD_JSON_ADC_CHAN);
+    point = cJSON_GetObjectItemCaseSensitive(root, CMD_JSON_ADC_POINT);
+    voltage = cJSON_GetObjectItemCaseSensitive(root, CMD_JSON_ADC_MV);
+    if (chan == NULL || !cJSON_IsNumber(chan) ||
+        point == NULL || !cJSON_IsNumber(point)) {
+        ESP_LOGE(TAG, "Wrong ADC_CALIBRATE format!");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "CMD ADC calibrate chan %d point %d",
+             chan->valueint, point->valueint);
+
+    if (point->valueint < 0) {
+        ret = adc_cal_clear(chan->valueint);
+    } else if (voltage == NULL || !cJSON_IsNumber(voltage)) {
+        ESP_LOGE(TAG, "Missing ADC calibration voltage!");
+        ret = ESP_FAIL;
+    } else {
+        /* Blocks until the point is averaged */
+        ret = adc_cal_point(chan->valueint, point->valueint, voltage->valueint);
+    }
+
+    send_adc_cal(chan->valueint, ret);
+
+    return ret;
+}
+
+static esp_err_t send_capture_info(esp_err_t res)
+{
+    cJSON *root = NULL;
+    char * string;
+    capture_hdr_t hdr;
+    esp_err_t ret;
+
+    root = cJSON_CreateObject();
+    if (root == NULL) {
+        ESP_LOGE(TAG, "Could not create JSON object!");
+        return ESP_FAIL;
+    }
+
+    if (capture_get_info(&hdr) != ESP_OK) {
+        memset(&hdr, 0, sizeof(hdr));
+    }
+
+    if (!cJSON_AddNumberToObject(root, CMD_JSON_CMD, CMD_GET_CAPTURE)         ||
+        !cJSON_AddStringToObject(root, CMD_JSON_CLIENT_ID, mqtt_client_id)    ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_TIME, time(NULL))             ||
+        !cJSON_AddStringToObject(root, CMD_JSON_RESULT,
+                                 res == ESP_OK ? "OK" : "ERROR")              ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_CAP_STATE, capture_get_state()) ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_CAP_REASON, hdr.reason)       ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_CAP_COUNT, hdr.total)) {
+        ESP_LOGE(TAG, "Could not add info to the response JSON!");
+
+        cJSON_Delete(root);
+        return ESP_FAIL;
+    }
+
+    string = cJSON_Print(root);
+
+    ret = mqtt_client_publish(mqtt_client_info.ctrl_handle,
+            mqtt_pub_topic, (const uint8_t*)string, strlen(string),
+            MQTT_PUB_QOS, 0);
+
+    /* Free allocated items */
+    cJSON_Delete(root);
+    free(string);
+
+    return ret;
+}
+
+/* Publish the frozen capture on the capture topic, one chunk per message */
+static esp_err_t send_capture(void)
+{
+    capture_hdr_t * hdr;
+    uint8_t * chunk;
+    int first, count, retry;
+    esp_err_t ret = ESP_OK;
+
+    chunk = malloc(sizeof(capture_hdr_t) +
+                   CMD_CAP_CHUNK_ENTRIES * sizeof(capture_entry_t));
+    if (chunk == NULL) {
+        ESP_LOGE(TAG, "Could not allocate the capture chunk!");
+        return ESP_FAIL;
+    }
+    hdr = (capture_hdr_t *)chunk;
+
+    if (capture_get_info(hdr) != ESP_OK) {
+        ESP_LOGE(TAG, "No capture available!");
+        free(chunk);
+        return ESP_FAIL;
+    }
+
+    for (first = 0; first < hdr->total; first += count) {
+        count = capture_read(first, (capture_entry_t *)(chunk + sizeof(capture_hdr_t)),
+                             CMD_CAP_CHUNK_ENTRIES);
+        hdr->first = first;
+        hdr->count = count;
+
+        /* Give the MQTT output buffer time to drain */
+        for (retry = 0; retry < CMD_CAP_RETRIES; retry++) {
+            ret = mqtt_client_publish(mqtt_client_info.ctrl_handle,
+                    mqtt_cap_topic, chunk,
+                    sizeof(capture_hdr_t) + count * sizeof(capture_entry_t),
+                    MQTT_PUB_QOS, 0);
+            if (ret == ESP_OK)
+                break;
+
+            vTaskDelay(CMD_CAP_RETRY_DELAY / portTICK_RATE_MS);
+        }
+
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Capture publish failed at entry %d!", first);
+            break;
+        }
+    }
+
+    free(chunk);
+
+    return ret;
+}
+
+static esp_err_t cmd_get_capture(cJSON *root)
+{
+    cJSON * arm = NULL;
+    esp_err_t ret;
+
+    arm = cJSON_GetObjectItemCaseSensitive(root, CMD_JSON_CAP_ARM);
+    if (arm != NULL && !cJSON_IsNumber(arm)) {
+        ESP_LOGE(TAG, "Wrong GET_CAPTURE format!");
+        return ESP_FAIL;
+    }
+
+    ret = send_capture();
+
+    send_capture_info(ret);
+
+    /* Only drop the capture once it was sent */
+    if (ret == ESP_OK && arm != NULL && arm->valueint) {
+        ESP_LOGI(TAG, "Capture armed");
+        capture_arm();
+    }
+
+    return ret;
+}
+
+static bool add_bench(cJSON *root, const char *name, const i2cdev_bench_t *res)
+{
+    cJSON *obj = cJSON_AddObjectToObject(root, name);
+    uint32_t bps = 0;
+
+    if (res->elapsed_us)
+        bps = (uint64_t)res->bytes * 1000000 / res->elapsed_us;
+
+    return obj != NULL &&
+           cJSON_AddNumberToObject(obj, CMD_JSON_BENCH_COUNT, res->transactions) &&
+           cJSON_AddNumberToObject(obj, CMD_JSON_BENCH_ERRORS, res->errors)      &&
+           cJSON_AddNumberToObject(obj, CMD_JSON_BENCH_BPS, bps)                 &&
+           cJSON_AddNumberToObject(obj, CMD_JSON_BENCH_LAT_MIN, res->lat_min_us) &&
+           cJSON_AddNumberToObject(obj, CMD_JSON_BENCH_LAT_AVG, res->lat_avg_us) &&
+           cJSON_AddNumberToObject(obj, CMD_JSON_BENCH_LAT_MAX, res->lat_max_us);
+}
+
+static esp_err_t send_i2c_bench(uint32_t stretch, esp_err_t res,
+                                const i2cdev_bench_t *adc, const i2cdev_bench_t *oled)
+{
+    cJSON *root = NULL;
+    char * string;
+    esp_err_t ret;
+
+    root = cJSON_CreateObject();
+    if (root == NULL) {
+        ESP_LOGE(TAG, "Could not create JSON object!");
+        return ESP_FAIL;
+    }
+
+    if (!cJSON_AddNumberToObject(root, CMD_JSON_CMD, CMD_I2C_BENCH)           ||
+        !cJSON_AddStringToObject(root, CMD_JSON_CLIENT_ID, mqtt_client_id)    ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_TIME, time(NULL))             ||
+        !cJSON_AddStringToObject(root, CMD_JSON_RESULT,
+                                 res == ESP_OK ? "OK" : "ERROR")              ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_BENCH_STRETCH, stretch)       ||
+        !add_bench(root, CMD_JSON_BENCH_ADC, adc)                             ||
+        !add_bench(root, CMD_JSON_BENCH_OLED, oled)) {
+        ESP_LOGE(TAG, "Could not add info to the response JSON!");
+
+        cJSON_Delete(root);
+        return ESP_FAIL;
+    }
+
+    string = cJSON_Print(root);
+
+    ret = mqtt_client_publish(mqtt_client_info.ctrl_handle,
+            mqtt_pub_topic, (const uint8_t*)string, strlen(string),
+            MQTT_PUB_QOS, 0);
+
+    /* Free allocated items */
+    cJSON_Delete(root);
+    free(string);
+
+    return ret;
+}
+
+static esp_err_t cmd_i2c_bench(cJSON *root)
+{
+    cJSON * hz = NULL;
+    cJSON * stretch = NULL;
+    cJSON * count = NULL;
+    i2cdev_bench_t adc, oled;
+    uint32_t n = CMD_BENCH_COUNT;
+    esp_err_t ret;
+
+    hz = cJSON_GetObjectItemCaseSensitive(root, CMD_JSON_BENCH_HZ);
+    stretch = cJSON_GetObjectItemCaseSensitive(root, CMD_JSON_BENCH_STRETCH);
+    count = cJSON_GetObjectItemCaseSensitive(root, CMD_JSON_BENCH_COUNT);
+    if ((stretch != NULL && !cJSON_IsNumber(stretch)) ||
+        (count != NULL && (!cJSON_IsNumber(count) || count->valueint <= 0))) {
+        ESP_LOGE(TAG, "Wrong I2C_BENCH format!");
+        return ESP_FAIL;
+    }
+    if (hz != NULL) {
+        /* The ESP8266 driver clocks the bus in software at a fixed rate */
+        ESP_LOGE(TAG, "I2C_BENCH %s is not supported!", CMD_JSON_BENCH_HZ);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (count != NULL)
+        n = count->valueint;
+
+    memset(&adc, 0, sizeof(adc));
+    memset(&oled, 0, sizeof(oled));
+
+    ret = adc_bench(stretch ? stretch->valueint : 0, n, &adc);
+    if (ret == ESP_OK)
+        ret = HAL_I2C_Bench(SSD1306_I2C_PORT, SSD1306_I2C_ADDR,
+                            stretch ? stretch->valueint : 0, n, &oled);
+
+    ESP_LOGI(TAG, "I2C bench: ADC %u B in %u us, OLED %u B in %u us",
+             adc.bytes, adc.elapsed_us, oled.bytes, oled.elapsed_us);
+
+    send_i2c_bench(stretch ? stretch->valueint : 0, ret, &adc, &oled);
+
+    return ret;
+}
+
+static esp_err_t send_i2c_dev_stats(const i2cdev_dev_stats_t *ds)
+{
+    cJSON *root = NULL;
+    cJSON *lat = NULL;
+    char * string;
+    esp_err_t ret = ESP_FAIL;
+    int i, retry;
+
+    root = cJSON_CreateObject();
+    if (root == NULL) {
+        ESP_LOGE(TAG, "Could not create JSON object!");
+        return ESP_FAIL;
+    }
+
+    if (!cJSON_AddNumberToObject(root, CMD_JSON_CMD, CMD_GET_I2C_STATS)       ||
+        !cJSON_AddStringToObject(root, CMD_JSON_CLIENT_ID, mqtt_client_id)    ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_TIME, time(NULL))             ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_ADDR, ds->addr)           ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_COUNT, ds->transactions)  ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_BYTES, ds->bytes)         ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_NACK, ds->err_nack)       ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_TIMEOUT, ds->err_timeout) ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_ERR, ds->err_other)       ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_BUSY, ds->busy_us)        ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_WAIT, ds->wait_us)        ||
+        !cJSON_AddNumberToObject(root, CMD_JSON_I2C_WAIT_MAX, ds->wait_max_us) ||
+        (lat = cJSON_AddArrayToObject(root, CMD_JSON_I2C_LAT)) == NULL) {
+        ESP_LOGE(TAG, "Could not add info to the response JSON!");
+
+        cJSON_Delete(root);
+        return ESP_FAIL;
+    }
+
+    for (i = 0; i < I2CDEV_LAT_BUCKETS; i++) {
+        if (!cJSON_AddItemToArray(lat, cJSON_CreateNumber(ds->lat_hist[i]))) {
+            ESP_LOGE(TAG, "Could not add info to the response JSON!");
+
+            cJSON_Delete(root);
+            return ESP_FAIL;
+        }
+    }
+
+    string = cJSON_Print(root);
+
+    /* One message per device, give the MQTT output buffer time to drain */
+    for (retry = 0; retry < CMD_CAP_RETRIES; retry++) {
+        ret = mqtt_client_publish(mqtt_client_info.ctrl_handle,
+                mqtt_pub_topic, (const uint8_t*)string, strlen(string),
+                MQTT_PUB_QOS, 0);
+        if (ret == ESP_OK)
+            break;
+
+        vTaskDelay(CMD_CAP_RETRY_DELAY / portTICK_RATE_MS);
+    }
+
+    /* Free allocated items */
+    cJSON_Delete(root);
+    free(string);
+
+    return ret;
+}
+
+static esp_err_t cmd_get_i2c_stats(cJSON *root)
+{
+    cJSON * clear = NULL;
+    i2cdev_dev_stats_t * stats;
+    int count = CONFIG_I2CDEV_STATS_DEVS;
+    esp_err_t ret;
+    int i;
+
+    clear = cJSON_GetObjectItemCaseSensitive(root, CMD_JSON_I2C_CLEAR);
+    if (clear != NULL && !cJSON_IsNumber(clear)) {
+        ESP_LOGE(TAG, "Wrong GET_I2C_STATS format!");
+        return ESP_FAIL;
+    }
+
+    stats = malloc(count * sizeof(i2cdev_dev_stats_t));
+    if (stats == NULL) {
+        ESP_LOGE(TAG, "Could not allocate the I2C stats!");
+        return ESP_FAIL;
+    }
+
+    ret = i2cdev_get_dev_stats(I2C_NUM_0, stats, &count,
+                               clear != NULL && clear->valueint);
+    for (i = 0; ret == ESP_OK && i < count; i++) {
+        ret = send_i2c_dev_stats(&stats[i]);
+    }
+
+    free(stats);
+
+    send_cmd_result(CMD_GET_I2C_STATS, ret);
+
+    return ret;
+}
 
 static void cmd_recv(cmd_data_t * cmd)
 {
@@ -529,6 +1022,22 @@ static void cmd_recv(cmd_data_t * cmd)
 
             break;
 
+        case CMD_ADC_CALIBRATE:
+            ret = cmd_adc_calibrate(root);
+            break;
+
+        case CMD_GET_CAPTURE:
+            ret = cmd_get_capture(root);
+            break;
+
+        case CMD_I2C_BENCH:
+            ret = cmd_i2c_bench(root);
+            break;
+
+        case CMD_GET_I2C_STATS:
+            ret = cmd_get_i2c_stats(root);
+            break;
+
         default:
             ESP_LOGE(TAG, "Command %d not implemented!", cmd_nr->valueint);
             break;
@@ -76,7 +76,10 @@ typedef enum {
     /*
      * Command JSON format: "{"cmd": 3}"
      * 
-     * Action: publish stats info, JSON format:
+     * Action: publish stats info, i2c_alloc and i2c_reuse count the I2C
+     * command links built and reused since the previous report. i2c_rec
+     * counts the I2C bus recoveries, i2c_rec_us is the longest one in us,
+     * JSON format:
      * {
      *         "cmd":  3,
      *         "id":   "ups",
@@ -88,6 +91,21 @@ typedef enum {
      *         "p_off":        62,
      *         "fan_high":     false,
      *         "adc_err":      0,
+     *         "adc_smp":      4096,
+     *         "adc_i2c":      8200,
+     *         "adc_nack":     0,
+     *         "adc_tmo":      0,
+     *         "adc_rdy":      0,
+     *         "adc_rng":      0,
+     *         "adc_rst":      0,
+     *         "adc_rec":      0,
+     *         "adc_stale":    false,
+     *         "i2c_alloc":    0,
+     *         "i2c_reuse":    5120,
+     *         "i2c_rec":      1,
+     *         "i2c_rec_fail": 0,
+     *         "i2c_rec_us":   850,
+     *         "i2c_stuck":    false,
      *         "bat_discharged":       3,
      *         "bat_connected":        true
      * }
@@ -130,6 +148,116 @@ typedef enum {
     /*
      * Not implemented
      */
+
+    CMD_ADC_CALIBRATE,
+    /*
+     * Command JSON format:
+     * {
+     *        "cmd":   8,
+     *        "chan":  2,
+     *        "point": 0,
+     *        "mv":    12000
+     * }
+     *
+     * chan: 0 v_bat, 1 v_out, 2 v_in, 3 v_sc (i_out, "mv" is in mA)
+     *
+     * Action: Two point calibration, apply a known reference voltage "mv" on
+     * the channel input and send point 0, then a second one and send point 1.
+     * Point 1 saves the calibration in the flash memory and uses it right
+     * away. Point -1 drops the saved calibration. Result JSON format:
+     * {
+     *        "cmd":  8,
+     *        "id":   "84f3eb23bcd5",
+     *        "time": 1550306592,
+     *        "res":  "OK",
+     *        "chan": 2,
+     *        "fs":   48012,
+     *        "ofs":  -35
+     * }
+     */
+
+    CMD_GET_CAPTURE,
+    /*
+     * Command JSON format:
+     * {
+     *        "cmd":  9,
+     *        "arm":  1
+     * }
+     *
+     * Action: Publish the power event capture, frozen on power off or battery
+     * disconnect, on topic sensors/capture/<id> as binary chunks: a
+     * capture_hdr_t followed by "count" capture_entry_t, see capture.h. With
+     * "arm" set the capture is released for the next event once sent. Then
+     * publish the result, JSON format:
+     * {
+     *        "cmd":    9,
+     *        "id":     "84f3eb23bcd5",
+     *        "time":   1550306592,
+     *        "res":    "OK",
+     *        "state":  2,
+     *        "reason": 1,
+     *        "n":      512
+     * }
+     */
+
+    CMD_I2C_BENCH,
+    /*
+     * Command JSON format:
+     * {
+     *        "cmd":     10,
+     *        "stretch": 4000,
+     *        "n":       100
+     * }
+     *
+     * Action: Time "n" (default 100, max 256) reads of the ADC conversion
+     * register, then "n" display chunk writes. They are queued at low
+     * priority, sampling and display updates keep going, and only the bus
+     * transfers are timed. "stretch" is the clock stretch timeout in CPU
+     * ticks, 0 or missing keeps the current one. While sampling only the ADC
+     * one is accepted. The SCL frequency is fixed on ESP8266, a "hz" field is
+     * refused. Result JSON format, "bps" is data bytes per second of bus
+     * time, latencies are in us:
+     * {
+     *        "cmd":     10,
+     *        "id":      "84f3eb23bcd5",
+     *        "time":    1550306592,
+     *        "res":     "OK",
+     *        "stretch": 4000,
+     *        "adc":     {"n": 100, "err": 0, "bps": 5800, "lat_min": 340, "lat_avg": 345, "lat_max": 410},
+     *        "oled":    {"n": 100, "err": 0, "bps": 9100, "lat_min": 1860, "lat_avg": 1870, "lat_max": 1990}
+     * }
+     */
+
+    CMD_GET_I2C_STATS,
+    /*
+     * Command JSON format:
+     * {
+     *        "cmd":   11,
+     *        "clear": 1
+     * }
+     *
+     * Action: Publish the I2C counters of every device on the bus, one
+     * message per device, then the command result. With "clear" set the
+     * counters restart from zero once read. "busy" and "wait" are the time
+     * on the bus and the time waiting for it, in us. "lat" is the histogram
+     * of the time on the bus, entry n counts the transactions of 2^n to
+     * 2^(n+1) - 1 us. JSON format:
+     * {
+     *        "cmd":      11,
+     *        "id":       "84f3eb23bcd5",
+     *        "time":     1550306592,
+     *        "addr":     72,
+     *        "n":        51200,
+     *        "bytes":    153600,
+     *        "nack":     0,
+     *        "tmo":      0,
+     *        "err":      0,
+     *        "busy":     17612800,
+     *        "wait":     2150400,
+     *        "wait_max": 1950,
+     *        "lat":      [0, 0, 0, 0, 0, 0, 0, 0, 51200, 0, 0, 0, 0, 0, 0, 0]
+     * }
+     */
 } cmd_number_t;
 
 esp_err_t send_sys_info();
@@ -0,0 +1,100 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+
+#include "ssd1306.h"
+#include "display.h"
+
+/* Below every other task, the panel shows what it gets when it gets it */
+#define DISPLAY_TASK_PRIORITY          4
+#define DISPLAY_TASK_STACK_SIZE        2048
+
+static const char *TAG = "DISPLAY";
+
+/* Last presented frame, owned by the flush task while it is sent */
+static SSD1306_Frame_t display_front;
+static SemaphoreHandle_t display_lock;
+
+/*
+ * Present signal. Not the task notification: the I2C waits of the flush
+ * run on it and would eat or fake a present.
+ */
+static SemaphoreHandle_t display_wake;
+
+static void display_task(void *arg)
+{
+    while (1)
+    {
+        xSemaphoreTake(display_wake, portMAX_DELAY);
+
+        xSemaphoreTake(display_lock, portMAX_DELAY);
+        ssd1306_UpdateFrame(&display_front);
+        xSemaphoreGive(display_lock);
+    }
+}
+
+bool display_present(void)
+{
+    /* No wait, so no priority inheritance to the flush task either */
+    if (xSemaphoreTake(display_lock, 0) != pdTRUE)
+        return false;
+
+    ssd1306_CopyFrame(&display_front);
+    xSemaphoreGive(display_lock);
+
+    xSemaphoreGive(display_wake);
+
+    return true;
+}
+
+esp_err_t display_start(void)
+{
+    /* ssd1306_Init() cleared the panel, the front frame matches it */
+    memset(&display_front, 0, sizeof(display_front));
+    memset(display_front.DirtyLo, 0xFF, sizeof(display_front.DirtyLo));
+
+    display_lock = xSemaphoreCreateMutex();
+    display_wake = xSemaphoreCreateBinary();
+    if (display_lock == NULL || display_wake == NULL)
+    {
+        ESP_LOGE(TAG, "Display could not create semaphores!");
+        return ESP_FAIL;
+    }
+
+    if (xTaskCreate(display_task, "display_task", DISPLAY_TASK_STACK_SIZE, NULL,
+        DISPLAY_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Display task could not be created!");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
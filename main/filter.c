@@ -0,0 +1,179 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "filter.h"
+
+/* Divide by 2^shift rounding to nearest, ties toward +inf */
+static inline int32_t round_shift(int32_t x, uint8_t shift)
+{
+    if (!shift)
+        return x;
+
+    return (x + (1 << (shift - 1))) >> shift;
+}
+
+void filter_init(filter_t *f, const filter_cfg_t *cfg)
+{
+    memset(f, 0, sizeof(filter_t));
+    f->cfg = *cfg;
+
+    switch (f->cfg.type) {
+        case FILTER_IIR:
+            if (f->cfg.shift > 15)
+                f->cfg.shift = 15;
+            break;
+
+        case FILTER_AVG:
+            if (f->cfg.shift > FILTER_AVG_SHIFT_MAX)
+                f->cfg.shift = FILTER_AVG_SHIFT_MAX;
+            break;
+
+        case FILTER_CIC:
+            if (f->cfg.order < 1)
+                f->cfg.order = 1;
+            if (f->cfg.order > FILTER_CIC_ORDER_MAX)
+                f->cfg.order = FILTER_CIC_ORDER_MAX;
+            if (f->cfg.order * f->cfg.shift > FILTER_CIC_GROWTH_MAX)
+                f->cfg.shift = FILTER_CIC_GROWTH_MAX / f->cfg.order;
+            break;
+
+        default:
+            f->cfg.type = FILTER_NONE;
+            break;
+    }
+}
+
+/*
+ * The accumulator keeps shift fractional bits and the correction is rounded,
+ * so the output settles exactly on a constant input instead of stopping up
+ * to 2^shift - 1 counts short like a truncating y += (x - y) >> shift.
+ */
+static bool filter_iir(filter_t *f, int32_t x)
+{
+    uint8_t shift = f->cfg.shift;
+
+    if (!f->init)
+        f->s.acc = x * (1 << shift);
+    else
+        f->s.acc += x - round_shift(f->s.acc, shift);
+
+    f->out = round_shift(f->s.acc, shift);
+
+    return true;
+}
+
+static bool filter_avg(filter_t *f, int32_t x)
+{
+    int len = 1 << f->cfg.shift;
+    int i;
+
+    /* Start with a full window of the first sample */
+    if (!f->init)
+    {
+        for (i = 0; i < len; i++)
+            f->s.avg.buf[i] = x;
+        f->s.avg.sum = x * len;
+    }
+
+    f->s.avg.sum += x - f->s.avg.buf[f->s.avg.idx];
+    f->s.avg.buf[f->s.avg.idx] = x;
+    f->s.avg.idx = (f->s.avg.idx + 1) & (len - 1);
+
+    f->out = round_shift(f->s.avg.sum, f->cfg.shift);
+
+    return true;
+}
+
+/*
+ * Integrators run at the input rate, combs with unit differential delay at
+ * the output rate. The gain is 2^(order * shift), removed with a rounding
+ * shift. Wrapping in the unsigned registers cancels out in the combs.
+ */
+static bool filter_cic(filter_t *f, int32_t x)
+{
+    uint8_t order = f->cfg.order;
+    uint32_t v, prev;
+    int i;
+
+    /* Hold the first sample until the combs are filled */
+    if (!f->init)
+        f->out = x;
+
+    v = (uint32_t)x;
+    for (i = 0; i < order; i++)
+    {
+        f->s.cic.integ[i] += v;
+        v = f->s.cic.integ[i];
+    }
+
+    if (++f->s.cic.count < (1 << f->cfg.shift))
+        return false;
+    f->s.cic.count = 0;
+
+    for (i = 0; i < order; i++)
+    {
+        prev = f->s.cic.comb[i];
+        f->s.cic.comb[i] = v;
+        v -= prev;
+    }
+
+    if (f->s.cic.settle < order)
+    {
+        f->s.cic.settle++;
+        return false;
+    }
+
+    f->out = round_shift((int32_t)v, order * f->cfg.shift);
+
+    return true;
+}
+
+bool filter_update(filter_t *f, int32_t x)
+{
+    bool ret;
+
+    switch (f->cfg.type) {
+        case FILTER_IIR:
+            ret = filter_iir(f, x);
+            break;
+
+        case FILTER_AVG:
+            ret = filter_avg(f, x);
+            break;
+
+        case FILTER_CIC:
+            ret = filter_cic(f, x);
+            break;
+
+        default:
+            f->out = x;
+            ret = true;
+            break;
+    }
+    f->init = true;
+
+    return ret;
+}
@@ -0,0 +1,98 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Adrian Bradianu (github.com/abradianu)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+/*
+ * Fixed point filters, integer math only and no SDK dependencies so the
+ * module also builds on the host, see host/filter_bench.c.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Max moving average window is 1 << FILTER_AVG_SHIFT_MAX */
+#define FILTER_AVG_SHIFT_MAX           4
+
+#define FILTER_CIC_ORDER_MAX           4
+
+/* Integrator growth is order * shift bits, 16 bit input must fit in 32 bits */
+#define FILTER_CIC_GROWTH_MAX          15
+
+typedef enum {
+    FILTER_NONE = 0,
+    /* Single pole IIR, y += (x - y) / 2^shift, fractional bits kept */
+    FILTER_IIR,
+    /* Moving average over the last 2^shift samples */
+    FILTER_AVG,
+    /* CIC decimator of the given order, one output every 2^shift samples */
+    FILTER_CIC,
+} filter_type_t;
+
+typedef struct {
+    filter_type_t type;
+    uint8_t shift;
+    uint8_t order;                     /* FILTER_CIC only */
+} filter_cfg_t;
+
+typedef struct {
+    filter_cfg_t cfg;
+    bool init;
+    int32_t out;
+    union {
+        int32_t acc;                   /* IIR: y << shift */
+        struct {
+            int32_t sum;
+            int32_t buf[1 << FILTER_AVG_SHIFT_MAX];
+            uint8_t idx;
+        } avg;
+        struct {
+            uint32_t integ[FILTER_CIC_ORDER_MAX];
+            uint32_t comb[FILTER_CIC_ORDER_MAX];
+            uint16_t count;
+            uint8_t settle;
+        } cic;
+    } s;
+} filter_t;
+
+/* Invalid settings are clamped to the supported range */
+void filter_init(filter_t *f, const filter_cfg_t *cfg);
+
+/*
+ * Feed one sample. Returns true when a new output was produced, which is
+ * every sample except for FILTER_CIC. The latest output is kept in f->out.
+ */
+bool filter_update(filter_t *f, int32_t x);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FILTER_H__ */
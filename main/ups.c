@@ -44,14 +44,18 @@
 #include "nvs_utils.h"
 #include "http_server_ap.h"
 #include "ssd1306.h"
-#include "ads111x.h"
+#include "display.h"
+#include "adc.h"
+#include "capture.h"
 #include "ssd1306_fonts.h"
+#include "ssd1306_text.h"
 #include "ssd1306_tests.h"
 
 #include "ups.h"
 
 /* Main task settings */
 #define MAIN_TASK_LOOP_DELAY           400
+#define MAIN_TASK_LOOP_TICKS           (MAIN_TASK_LOOP_DELAY / portTICK_RATE_MS)
 #define MAIN_TASK_PRIORITY             10
 #define MAIN_TASK_STACK_SIZE           4096
 
@@ -62,6 +66,9 @@
 #define GPIO_I2C_MASTER_SCL            4
 #define GPIO_I2C_MASTER_SDA            5
 
+/* ADS111x ALERT/RDY GPIO input */
+#define GPIO_ADC_ALERT                 14
+
 /* Vbuck status GPIO input */
 #define GPIO_VBUCK_STATUS              12
 
@@ -92,11 +99,19 @@
 /* short circuit rezistor in mili ohmi */
 #define REZISTOR_SC                    100
 
+/* i_out in mA at the ADC full scale, 2.048V across the shunt */
+#define I_OUT_FULL_SCALE               (2048 * 1000 / REZISTOR_SC)
+
 #define V_BAT_FAN_LOW                  13400
 #define I_OUT_FAN_LOW                  1000
 #define FAN_MIN_PERIOD                 30
 
-#define ADC_BUSY_RETRIES               10
+/*
+ * A channel without a sample for this long is stale, ms. The slowest channel
+ * is due every ~0.5s, the ADC task gives up on the bus in less than 3s.
+ */
+#define ADC_STALE_TIME                 3000
+#define ADC_STALE_TICKS                (ADC_STALE_TIME / portTICK_RATE_MS)
 
 /*
  * std offset dst [offset],start[/time],end[/time]
@@ -122,6 +137,14 @@ do {                                                  \
     esp_restart();                                    \
 } while (0)
 
+typedef enum {
+    UPS_CHAN_V_BAT,
+    UPS_CHAN_V_OUT,
+    UPS_CHAN_V_IN,
+    UPS_CHAN_V_SC,
+    UPS_CHAN_MAX
+} ups_chan_t;
+
 typedef enum {
     WIFI_AP_MODE,
     WIFI_STA_DISCONNECTED,
@@ -130,10 +153,35 @@ typedef enum {
 
 static const char *TAG = "UPS";
 static wifi_mode_state_t wifi_state;
-static i2c_dev_t adc_dev;
 static ups_data_t ups_data;
 static SemaphoreHandle_t ups_mutex = NULL;
 
+/* ADS111x devices, ALERT/RDY is connected on the first one */
+static const uint8_t adc_addrs[] = {
+    ADS111X_ADDR_GND,
+};
+
+/*
+ * A conversion slot is ~16ms at 64 SPS, v_bat changes slowly. Power fail is
+ * detected by the ADC comparator while the engine is parked on v_in, within
+ * one slot. While the other channels are due v_in takes every other slot, so
+ * a power fail is seen within two slots, ~31ms. The v_in period below only
+ * applies when the power is off, v_in then gets all the free slots. The full
+ * scale is the input voltage read as ADS111X_MAX_VALUE through the resistor
+ * dividers, replaced by the calibration saved in the NVS if any. v_sc is read
+ * as i_out in mA, with the PGA gain ranging up to 0.256V full scale at low
+ * load.
+ */
+static const adc_chan_cfg_t adc_chans[UPS_CHAN_MAX] = {
+    /* v_bat is noisy when battery is fully charged, ~2s time constant */
+    [UPS_CHAN_V_BAT] = {ADS111X_MUX_0_GND, 18840, 32, 0, {FILTER_IIR, 2}},
+    [UPS_CHAN_V_OUT] = {ADS111X_MUX_1_GND, 22270, 16, 1, {FILTER_AVG, 2}},
+    [UPS_CHAN_V_IN]  = {ADS111X_MUX_2_GND, 48000,  8, 3, {FILTER_NONE}},
+    /* i_out, ~2s time constant */
+    [UPS_CHAN_V_SC]  = {ADS111X_MUX_3_GND, I_OUT_FULL_SCALE, 8, 2, {FILTER_IIR, 4},
+                        ADS111X_GAIN_0V256},
+};
+
 static void sntp_start(void)
 {
     ESP_LOGI(TAG, "SNTP start");
@@ -253,84 +301,6 @@ static esp_err_t uart_init(void)
     return (uart_param_config(0, &uart_config));
 }
 
-static esp_err_t adc_init(void)
-{
-    ESP_LOGI(TAG, "ADC init");
-    
-    if (ads111x_init_desc(&adc_dev, ADS111X_ADDR_GND, I2C_NUM_0, 
-                      GPIO_I2C_MASTER_SDA, GPIO_I2C_MASTER_SCL))
-    {
-        ESP_LOGE(TAG, "ADC init failed!");
-        return ESP_FAIL;
-    }
-    
-    if (ads111x_set_data_rate(&adc_dev, ADS111X_DATA_RATE_64) != ESP_OK)
-    {
-        ESP_LOGE(TAG, "ADC set data rate failed!");
-        return ESP_FAIL;
-    }
-
-    if (ads111x_set_mode(&adc_dev, ADS111X_MODE_SINGLE_SHOT) != ESP_OK)
-    {
-        ESP_LOGE(TAG, "ADC set mode failed!");
-        return ESP_FAIL;
-    }
-
-    return ESP_OK;
-}
-
-static esp_err_t adc_read(int chan, int * voltage)
-{
-    bool not_busy = false;
-    int16_t raw = 0;
-    int retries = 0;
-    /* gain * 1000 */
-    static int gain[] = {0, 0, 0, 0, 18840, 22270, 48000, 2048};
-
-    if (ads111x_set_input_mux(&adc_dev, chan) != ESP_OK)
-    {
-        ESP_LOGE(TAG, "ADC failed to set input on chan %d!", chan);
-        return ESP_FAIL;
-    }
-    
-    if (ads111x_start_conversion(&adc_dev) != ESP_OK)
-    {
-        ESP_LOGE(TAG, "ADC failed to start conversion on chan %d!", chan);
-        return ESP_FAIL;
-    }
-
-    /* Wait for conversion to finish, for 64 SPS conversion time is ~15ms */
-    vTaskDelay(20 / portTICK_RATE_MS);
-    do
-    {
-        ads111x_is_busy(&adc_dev, &not_busy);
-        if (not_busy)
-            break;
-        retries++;
-        vTaskDelay(1);
-    } while (retries < ADC_BUSY_RETRIES);
-
-    if (retries == ADC_BUSY_RETRIES)
-    {
-        ESP_LOGE(TAG, "ADC conversion timeout on chan %d!", chan);
-        return ESP_FAIL;
-    }
-    
-    if (ads111x_get_value(&adc_dev, &raw) == ESP_OK)
-    {
-        *voltage = ((int)raw * gain[chan]) / ADS111X_MAX_VALUE;
-        ESP_LOGV(TAG, "ADC chan %d raw value %d, voltage: %d mV\n",
-                 chan, raw, *voltage);
-    }
-    else
-    {
-        ESP_LOGE(TAG, "ADC get value failed on chan %d!", chan);
-        return ESP_FAIL;
-    }
-    
-    return ESP_OK;
-}
-
 static esp_err_t gpio_init(void)
 {
     gpio_config_t io_conf;
@@ -358,16 +328,44 @@ static esp_err_t gpio_init(void)
     return ESP_OK;
 }
 
+/* Must be called with ups_mutex taken */
+static void ups_set_adc_stats(bool stale)
+{
+    adc_stats_t adc_stats;
+
+    adc_get_stats(&adc_stats);
+    ups_data.adc_errors = adc_stats.errors;
+    ups_data.adc_samples = adc_stats.samples;
+    ups_data.adc_i2c_transactions = adc_stats.i2c_transactions;
+    ups_data.adc_nack = adc_stats.nack;
+    ups_data.adc_i2c_timeout = adc_stats.i2c_timeout;
+    ups_data.adc_rdy_timeout = adc_stats.rdy_timeout;
+    ups_data.adc_out_of_range = adc_stats.out_of_range;
+    ups_data.adc_resets = adc_stats.resets;
+    ups_data.adc_recoveries = adc_stats.recoveries;
+    ups_data.adc_stale = stale;
+}
+
 static void main_task(void *arg)
 {
     uint8_t blink_level = 1;
     uint32_t power_off = 0;
     uint32_t bat_discharged = 0;
-    uint32_t adc_errors = 0;
     TickType_t fan_tick_count = 0;
+    TickType_t refresh_tick, elapsed;
     bool init_done = false;
-    int v_out, i_out, v_bat, v_in, v_sc, v_bat_prev, i_out_prev;
+    int v_out, i_out, v_bat, i_sc;
+    int v_in = 0;
     char text[16];
+    SSD1306_TextRow_t rows[3];
+    int i;
+    int adc_values[UPS_CHAN_MAX];
+    int adc_filtered[UPS_CHAN_MAX];
+    TickType_t adc_tick[UPS_CHAN_MAX];
+    uint32_t adc_valid = 0;
+    adc_sample_t sample;
+    bool adc_stale = false;
+    bool stale;
     bool first_time = true;
     bool bat_connected = false;
     bool power_is_on = false;
@@ -378,7 +376,7 @@ static void main_task(void *arg)
     ssd1306_WriteString("12V UPS", Font_16x26, White);
     ssd1306_SetCursor(2, 40);
     ssd1306_WriteString("FW: "FW_VERSION, Font_11x18, White);
-    ssd1306_UpdateScreen();
+    display_present();
 
     nvs_get_u32(nvs_get_handle(), NVS_POWER_OFF, &power_off);
     nvs_get_u32(nvs_get_handle(), NVS_BATTERY_DISCHARGED, &bat_discharged);
@@ -387,9 +385,59 @@ static void main_task(void *arg)
     vTaskDelay(2000 / portTICK_RATE_MS);
 
     ssd1306_Fill(Black);
-    ssd1306_UpdateScreen();
+    display_present();
+
+    /* Status rows, redrawn cell by cell as the text changes */
+    ssd1306_TextInit(&rows[0], 2, 0, &Font_11x18, White);
+    ssd1306_TextInit(&rows[1], 2, 22, &Font_11x18, White);
+    ssd1306_TextInit(&rows[2], 2, 42, &Font_11x18, White);
+
+    if (adc_set_trip(UPS_CHAN_V_IN, V_IN_GOOD) != ESP_OK ||
+        adc_start(adc_chans, UPS_CHAN_MAX) != ESP_OK) {
+        FATAL_ERROR("ADC not started!");
+    }
+    refresh_tick = xTaskGetTickCount();
+    for (i = 0; i < UPS_CHAN_MAX; i++)
+        adc_tick[i] = refresh_tick;
 
     while (1) {
+        elapsed = xTaskGetTickCount() - refresh_tick;
+        if (adc_get_sample(&sample, elapsed < MAIN_TASK_LOOP_TICKS ?
+                           MAIN_TASK_LOOP_TICKS - elapsed : 0) == ESP_OK)
+        {
+            adc_values[sample.chan] = sample.voltage;
+            adc_filtered[sample.chan] = sample.filtered;
+            adc_tick[sample.chan] = sample.tick;
+            adc_valid |= 1 << sample.chan;
+            capture_push(&sample);
+
+            if (sample.chan != UPS_CHAN_V_IN)
+                continue;
+
+            v_in = sample.voltage;
+            if (v_in < 0) v_in = 0;
+
+            /* Check power on state on every v_in sample */
+            if (v_in < V_IN_GOOD && power_is_on)
+            {
+                power_is_on = false;
+
+                power_off++;
+                nvs_set_u32(nvs_get_handle(), NVS_POWER_OFF, power_off);
+                capture_trigger(CAPTURE_POWER_OFF);
+
+                ESP_LOGI(TAG, "Power off!");
+            }
+            else if (v_in >= V_IN_GOOD && !power_is_on)
+            {
+                power_is_on = true;
+
+                ESP_LOGI(TAG, "Power on!");
+            }
+            continue;
+        }
+        refresh_tick = xTaskGetTickCount();
+
         if (wifi_state == WIFI_STA_CONNECTED && !init_done) {
 
             /* We are connected to WiFi now */
@@ -406,31 +454,61 @@ static void main_task(void *arg)
         blink_level ^= 1;
         gpio_set_level(GPIO_BLUE_LED, blink_level);
 
-        if (adc_read(ADS111X_MUX_0_GND, &v_bat) != ESP_OK ||
-            adc_read(ADS111X_MUX_1_GND, &v_out) != ESP_OK ||
-            adc_read(ADS111X_MUX_2_GND, &v_in)  != ESP_OK ||
-            adc_read(ADS111X_MUX_3_GND, &v_sc)  != ESP_OK)
+        /* No decision is taken on old readings, a channel never sampled included */
+        stale = false;
+        for (i = 0; i < UPS_CHAN_MAX; i++)
         {
-            adc_errors++;
-            vTaskDelay(1);
-            continue;
+            if (refresh_tick - adc_tick[i] > ADC_STALE_TICKS)
+                stale = true;
         }
 
-        if (v_in < 0) v_in = 0;
-        if (v_sc < 0) v_sc = 0;
-        i_out = (v_sc * 1000) / REZISTOR_SC;
-        if (first_time)
+        if (stale != adc_stale)
         {
-            v_bat_prev = v_bat;
-            i_out_prev = i_out;
+            adc_stale = stale;
+            if (stale)
+                ESP_LOGE(TAG, "ADC readings stale, fan high and battery relay frozen!");
+            else
+                ESP_LOGI(TAG, "ADC readings back");
+
+            ssd1306_Fill(Black);
+            for (i = 0; i < sizeof(rows) / sizeof(rows[0]); i++)
+                ssd1306_TextInvalidate(&rows[i]);
+        }
+
+        if (adc_stale)
+        {
+            /* Safe state: full cooling, the battery relay keeps its state */
+            if (!fan_high)
+            {
+                gpio_set_level(GPIO_FAN_CONTROL, FAN_HIGH);
+                fan_tick_count = xTaskGetTickCount();
+                fan_high = true;
+            }
+
+            xSemaphoreTake(ups_mutex, portMAX_DELAY);
+            ups_data.fan_high = fan_high;
+            ups_set_adc_stats(true);
+            xSemaphoreGive(ups_mutex);
+
+            if (blink_level)
+                ssd1306_TextSet(&rows[1], "ADC ERROR");
+            else
+                ssd1306_TextClear(&rows[1]);
+            display_present();
+            continue;
         }
 
-        /* low pass filter, v_bat is noisy when battery is fully charged */
-        v_bat = v_bat_prev + (v_bat - v_bat_prev) / 5;
-        v_bat_prev = v_bat;
+        /* Wait for every channel to be sampled at least once */
+        if (adc_valid != (1 << UPS_CHAN_MAX) - 1)
+            continue;
+
+        v_bat = adc_filtered[UPS_CHAN_V_BAT];
+        v_out = adc_filtered[UPS_CHAN_V_OUT];
+        i_sc  = adc_values[UPS_CHAN_V_SC];
 
-        i_out = i_out_prev + (i_out - i_out_prev) / 5;
-        i_out_prev = i_out;
+        if (i_sc < 0) i_sc = 0;
+        i_out = adc_filtered[UPS_CHAN_V_SC];
+        if (i_out < 0) i_out = 0;
 
         /* Check battery state */
         if (bat_connected)
@@ -443,6 +521,7 @@ static void main_task(void *arg)
                 bat_connected = false;
                 bat_discharged++;
                 nvs_set_u32(nvs_get_handle(), NVS_BATTERY_DISCHARGED, bat_discharged);
+                capture_trigger(CAPTURE_BAT_DISCONNECT);
                 
                 ESP_LOGI(TAG, "Battery discharged and disconnected!");
             }
@@ -467,24 +546,6 @@ static void main_task(void *arg)
         }
         first_time = false;
 
-        /* Check power on state */
-        if (v_in < V_IN_GOOD && power_is_on)
-        {
-            power_is_on = false;
-
-            power_off++;
-            nvs_set_u32(nvs_get_handle(), NVS_POWER_OFF, power_off);
-            
-            ESP_LOGI(TAG, "Power off!");
-        }
-        else if (v_in >= V_IN_GOOD && !power_is_on)
-        {
-            power_is_on = true;
-            
-            ESP_LOGI(TAG, "Power on!");
-        }
-
-
         /* Check fan state, minimum period once state changed */
         if (xTaskGetTickCount() - fan_tick_count > FAN_MIN_PERIOD * xPortGetTickRateHz())
         {
@@ -520,58 +581,53 @@ static void main_task(void *arg)
         ups_data.bat_discharged = bat_discharged;
         ups_data.bat_connected = bat_connected;
         ups_data.fan_high = fan_high;
-        ups_data.adc_errors = adc_errors;
+        ups_set_adc_stats(false);
         xSemaphoreGive(ups_mutex);
 
         /* Display first text row, Vout and Iout */
         v_out = v_out + 50;
-        i_out = ((v_sc * 1000) / REZISTOR_SC) + 5;
+        i_out = i_sc + 5;
         if (i_out > CURRENT_MAX && blink_level == 0)
         {
             /* Out current over limit, blink text */
-            snprintf(text, sizeof(text), "             ");
+            ssd1306_TextClear(&rows[0]);
         }
         else
         {
             snprintf(text, sizeof(text), "%02d.%dV %d.%02dA",
                      v_out / 1000, (v_out % 1000) / 100,
                      i_out / 1000, (i_out % 1000) / 10);
+            ssd1306_TextSet(&rows[0], text);
         }
-        ssd1306_SetCursor(2, 0);
-        ssd1306_WriteString(text, Font_11x18, White);
 
         /* Display second text row, Vbat */
         v_bat = v_bat + 50;
         if (!bat_connected && blink_level == 0)
         {
             /* Battery not connected, blink text */
-            snprintf(text, sizeof(text), "             ");
+            ssd1306_TextClear(&rows[1]);
         }
         else
         {
             snprintf(text, sizeof(text), "Vbat%c %d.%dV ", blink_level ? ':':' ',
                 v_bat / 1000, (v_bat % 1000) / 100);
+            ssd1306_TextSet(&rows[1], text);
         }
-        ssd1306_SetCursor(2, 22);
-        ssd1306_WriteString(text, Font_11x18, White);
 
         /* Display third text row, Poff status */
         if (!power_is_on && blink_level == 0)
         {
             /* Power is off, blink text */
-            snprintf(text, sizeof(text), "             ");
+            ssd1306_TextClear(&rows[2]);
         }
         else
         {
             snprintf(text, sizeof(text), "Poff%c %d    ",  blink_level ? ':':' ',
                                          power_off);
+            ssd1306_TextSet(&rows[2], text);
         }
-        ssd1306_SetCursor(2, 42);
-        ssd1306_WriteString(text, Font_11x18, White);
-
-        ssd1306_UpdateScreen();
 
-        vTaskDelay(MAIN_TASK_LOOP_DELAY / portTICK_RATE_MS);
+        display_present();
     }
 }
 
@@ -596,7 +652,9 @@ void app_main()
         gpio_init() != ESP_OK   ||
         i2cdev_init() != ESP_OK ||
         nvs_init() != ESP_OK    ||
-        adc_init() != ESP_OK) {
+        adc_init(I2C_NUM_0, GPIO_I2C_MASTER_SDA, GPIO_I2C_MASTER_SCL,
+                 GPIO_ADC_ALERT, adc_addrs,
+                 sizeof(adc_addrs) / sizeof(adc_addrs[0])) != ESP_OK) {
         FATAL_ERROR("Could not init drivers!");
     }
 
@@ -618,6 +676,9 @@ void app_main()
     nvs = nvs_get_handle();
 
     ssd1306_Init();
+    if (display_start() != ESP_OK) {
+        FATAL_ERROR("Display not started!");
+    }
 
     /* Read WiFi mode from flash*/
     nvs_get_u8(nvs, NVS_WIFI_AP_MODE, &ap_mode);
@@ -40,6 +40,15 @@ typedef struct {
     int power_off;
     int bat_discharged;
     int adc_errors;
+    uint32_t adc_samples;
+    uint32_t adc_i2c_transactions;
+    uint32_t adc_nack;
+    uint32_t adc_i2c_timeout;
+    uint32_t adc_rdy_timeout;
+    uint32_t adc_out_of_range;
+    uint32_t adc_resets;
+    uint32_t adc_recoveries;
+    bool adc_stale;
     bool bat_connected;
     bool fan_high;
     